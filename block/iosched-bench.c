@@ -0,0 +1,769 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * I/O scheduler benchmark: replays a recorded workload against a block
+ * device, through whatever elevator the device currently uses, and
+ * reports throughput, latency percentiles and fairness.
+ *
+ * The workload is a text file with one request per line:
+ *
+ *	<usec> <pid> <rwbs> <sector> <sectors>
+ *
+ * <rwbs> follows blktrace: 'D' is a discard, 'F' without sectors a flush,
+ * 'R' a sync read, 'W' an async write and "WS" a sync write. A trace of
+ * issued requests can be converted with:
+ *
+ *	blkparse -i sda -a issue -f "%T %t %p %d %S %n\n" |
+ *	awk '{ printf "%d %s %s %s %s\n", $1 * 1000000 + $2 / 1000,
+ *	       $3, $4, $5, $6 }'
+ *
+ * and is used with:
+ *
+ *	cat workload > /sys/kernel/debug/iosched-bench/trace
+ *	echo /dev/ram0 > /sys/kernel/debug/iosched-bench/run
+ *	cat /sys/kernel/debug/iosched-bench/result
+ *
+ * Writing to "run" only returns once the replay is done. Requests are
+ * issued at their recorded time scaled by "speed" (percent, 0 issues
+ * them as fast as possible), with at most "depth" of them in flight.
+ * With "threads" above 1, the requests are issued round robin by that
+ * many kernel threads, to load the elevator insertion path from several
+ * cpus; speed 0 and a large depth then measure the insertion rate.
+ * Sectors beyond the end of the device wrap around. The written data
+ * is garbage, so only use scratch devices such as brd.
+ *
+ * Fairness is Jain's index of the mean latency of the requests of each
+ * pid in the trace, 1000 meaning all of them were served alike.
+ */
+
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/sort.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+
+#define MODULE_NAME "iosched-bench"
+
+#define BENCH_MAX_REQS		(1 << 20)
+#define BENCH_MAX_STREAMS	64
+#define BENCH_MAX_LINE		128
+/* Largest read/write issued, larger ones are truncated */
+#define BENCH_MAX_PAGES		128
+#define BENCH_DEF_DEPTH		32
+#define BENCH_DEF_SPEED		100
+#define BENCH_MAX_THREADS	32
+#define BENCH_MODE	(FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+#define bench_pr_info(fmt, args...) pr_info("%s: "fmt"\n", MODULE_NAME, args)
+#define bench_pr_err(fmt, args...) pr_err("%s: "fmt"\n", MODULE_NAME, args)
+
+/**
+ * enum bench_op - types of the replayed requests
+ */
+enum bench_op {
+	BENCH_READ,
+	BENCH_WRITE,
+	BENCH_SWRITE,
+	BENCH_DISCARD,
+	BENCH_FLUSH,
+	BENCH_NR_OPS,
+};
+
+static const char * const bench_op_name[BENCH_NR_OPS] = {
+	"read", "write", "swrite", "discard", "flush",
+};
+
+/**
+ * struct bench_req - a request of the workload
+ * @time_us:	issue time, relative to the first request
+ * @sector:	start sector
+ * @nr_sects:	number of sectors
+ * @stream:	index of the pid in struct bench_data.pids
+ * @op:		enum bench_op
+ * @skipped:	could not be issued in the last run
+ * @err:	completion error
+ * @start:	actual issue time
+ * @lat_us:	completion latency
+ * @bytes:	bytes actually transferred
+ */
+struct bench_req {
+	u64 time_us;
+	u64 sector;
+	u32 nr_sects;
+	u16 stream;
+	u8 op;
+	bool skipped;
+	int err;
+	ktime_t start;
+	u32 lat_us;
+	u32 bytes;
+};
+
+/**
+ * struct bench_data - global benchmark data
+ * @lock:	serializes trace loading, runs and result reading
+ * @reqs:	the workload
+ * @nr_reqs:	number of requests in @reqs
+ * @max_reqs:	allocated size of @reqs
+ * @line:	partial line carried over between trace writes
+ * @line_len:	length of @line
+ * @pids:	pids of the streams in the workload
+ * @nr_pids:	number of used entries in @pids
+ * @pages:	data pages of reads and writes
+ * @inflight:	number of requests in flight
+ * @wait:	waits for requests completion
+ * @depth:	max number of requests in flight
+ * @speed:	replay speed, in percent of the recorded one
+ * @threads:	number of threads issuing the requests
+ * @submit_us:	time the last run took to issue all requests
+ * @elapsed_us:	duration of the last run
+ * @skipped:	requests of the last run that could not be issued
+ * @dev_name:	device of the last run
+ * @elv_name:	elevator of the last run
+ */
+struct bench_data {
+	struct mutex lock;
+	struct bench_req *reqs;
+	unsigned int nr_reqs;
+	unsigned int max_reqs;
+	char line[BENCH_MAX_LINE];
+	int line_len;
+	pid_t pids[BENCH_MAX_STREAMS];
+	int nr_pids;
+	struct page *pages[BENCH_MAX_PAGES];
+	atomic_t inflight;
+	wait_queue_head_t wait;
+	u32 depth;
+	u32 speed;
+	u32 threads;
+	u64 submit_us;
+	u64 elapsed_us;
+	unsigned int skipped;
+	char dev_name[BDEVNAME_SIZE];
+	char elv_name[ELV_NAME_MAX];
+};
+
+static struct bench_data bench;
+static struct dentry *bench_debug_root;
+
+/* Streams beyond BENCH_MAX_STREAMS share the last one */
+static u16 bench_get_stream(pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < bench.nr_pids; i++)
+		if (bench.pids[i] == pid)
+			return i;
+
+	if (bench.nr_pids == BENCH_MAX_STREAMS)
+		return BENCH_MAX_STREAMS - 1;
+
+	bench.pids[bench.nr_pids] = pid;
+	return bench.nr_pids++;
+}
+
+static int bench_parse_op(const char *rwbs, u32 nr_sects)
+{
+	if (strchr(rwbs, 'D'))
+		return BENCH_DISCARD;
+	if (strchr(rwbs, 'F') && !nr_sects)
+		return BENCH_FLUSH;
+	if (!nr_sects)
+		return -EINVAL;
+	if (strchr(rwbs, 'R'))
+		return BENCH_READ;
+	if (strchr(rwbs, 'W'))
+		return strchr(rwbs, 'S') ? BENCH_SWRITE : BENCH_WRITE;
+	return -EINVAL;
+}
+
+static int bench_add_req(char *line)
+{
+	struct bench_req *req;
+	unsigned long long time_us, sector;
+	char rwbs[9];
+	u32 nr_sects;
+	int pid, op;
+
+	if (sscanf(line, "%llu %d %8s %llu %u", &time_us, &pid, rwbs,
+		   &sector, &nr_sects) != 5)
+		return -EINVAL;
+
+	op = bench_parse_op(rwbs, nr_sects);
+	if (op < 0)
+		return op;
+
+	if (bench.nr_reqs == bench.max_reqs) {
+		unsigned int max = bench.max_reqs ? bench.max_reqs * 2 : 4096;
+		struct bench_req *reqs;
+
+		if (max > BENCH_MAX_REQS)
+			return -E2BIG;
+		reqs = vmalloc(max * sizeof(*reqs));
+		if (!reqs)
+			return -ENOMEM;
+		if (bench.reqs) {
+			memcpy(reqs, bench.reqs,
+			       bench.nr_reqs * sizeof(*reqs));
+			vfree(bench.reqs);
+		}
+		bench.reqs = reqs;
+		bench.max_reqs = max;
+	}
+
+	req = &bench.reqs[bench.nr_reqs++];
+	memset(req, 0, sizeof(*req));
+	req->time_us = time_us;
+	req->sector = sector;
+	req->nr_sects = nr_sects;
+	req->stream = bench_get_stream(pid);
+	req->op = op;
+
+	return 0;
+}
+
+static void bench_reset_trace(void)
+{
+	vfree(bench.reqs);
+	bench.reqs = NULL;
+	bench.nr_reqs = bench.max_reqs = 0;
+	bench.line_len = 0;
+	bench.nr_pids = 0;
+	bench.elapsed_us = 0;
+}
+
+static int bench_trace_open(struct inode *inode, struct file *file)
+{
+	if ((file->f_mode & FMODE_WRITE) && (file->f_flags & O_TRUNC)) {
+		mutex_lock(&bench.lock);
+		bench_reset_trace();
+		mutex_unlock(&bench.lock);
+	}
+
+	return nonseekable_open(inode, file);
+}
+
+/*
+ * Lines may be split across writes, the end of the last one is kept in
+ * bench.line. Empty lines and lines starting with '#' are ignored.
+ */
+static ssize_t bench_trace_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	size_t i;
+	char c;
+	int ret = 0;
+
+	mutex_lock(&bench.lock);
+	for (i = 0; i < count; i++) {
+		if (get_user(c, buf + i)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		if (c != '\n') {
+			if (bench.line_len == BENCH_MAX_LINE - 1) {
+				ret = -EINVAL;
+				break;
+			}
+			bench.line[bench.line_len++] = c;
+			continue;
+		}
+
+		bench.line[bench.line_len] = '\0';
+		bench.line_len = 0;
+		if (!bench.line[0] || bench.line[0] == '#')
+			continue;
+
+		ret = bench_add_req(bench.line);
+		if (ret) {
+			bench_pr_err("bad trace line %u: %s", bench.nr_reqs + 1,
+				     bench.line);
+			break;
+		}
+	}
+	mutex_unlock(&bench.lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= bench_trace_open,
+	.write		= bench_trace_write,
+	.llseek		= no_llseek,
+};
+
+static void bench_end_io(struct bio *bio, int err)
+{
+	struct bench_req *req = bio->bi_private;
+
+	req->lat_us = ktime_us_delta(ktime_get(), req->start);
+	req->err = err;
+	bio_put(bio);
+
+	atomic_dec(&bench.inflight);
+	wake_up(&bench.wait);
+}
+
+/* Returns the bio of @req, or NULL if the device can't take it */
+static struct bio *bench_build_bio(struct block_device *bdev,
+				   struct bench_req *req, int *rw)
+{
+	struct request_queue *q = bdev_get_queue(bdev);
+	sector_t capacity = i_size_read(bdev->bd_inode) >> 9;
+	unsigned int lbs_sects = bdev_logical_block_size(bdev) >> 9;
+	unsigned int max_sects = BENCH_MAX_PAGES << (PAGE_SHIFT - 9);
+	unsigned int nr_sects = min(req->nr_sects, max_sects);
+	u64 sector = req->sector, span;
+	struct bio *bio;
+	int i, nr_pages;
+
+	switch (req->op) {
+	case BENCH_FLUSH:
+		*rw = WRITE_FLUSH;
+		return bio_alloc(GFP_KERNEL, 0);
+	case BENCH_DISCARD:
+		if (!blk_queue_discard(q))
+			return NULL;
+		nr_sects = min(req->nr_sects, q->limits.max_discard_sectors);
+		*rw = REQ_WRITE | REQ_DISCARD;
+		break;
+	case BENCH_READ:
+		*rw = READ_SYNC;
+		break;
+	case BENCH_SWRITE:
+		*rw = WRITE_SYNC;
+		break;
+	default:
+		*rw = WRITE;
+		break;
+	}
+
+	nr_sects = round_down(nr_sects, lbs_sects);
+	if (!nr_sects || nr_sects > capacity)
+		return NULL;
+	span = capacity - nr_sects + 1;
+	sector -= div64_u64(sector, span) * span;
+	sector = round_down(sector, lbs_sects);
+
+	nr_pages = req->op == BENCH_DISCARD ? 0 :
+		DIV_ROUND_UP(nr_sects << 9, PAGE_SIZE);
+	bio = bio_alloc(GFP_KERNEL, nr_pages);
+	if (!bio)
+		return NULL;
+
+	bio->bi_sector = sector;
+	if (req->op == BENCH_DISCARD) {
+		bio->bi_size = nr_sects << 9;
+		return bio;
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		unsigned int len = min_t(unsigned int, PAGE_SIZE,
+					 (nr_sects << 9) - i * PAGE_SIZE);
+
+		/* Truncated by the queue limits */
+		if (bio_add_page(bio, bench.pages[i], len, 0) < len)
+			break;
+	}
+	if (!bio->bi_size) {
+		bio_put(bio);
+		return NULL;
+	}
+
+	return bio;
+}
+
+/* Sleeps until @time_us after @start, scaled by the replay speed */
+static void bench_wait_issue_time(ktime_t start, u64 time_us)
+{
+	ktime_t at;
+
+	if (!bench.speed)
+		return;
+
+	time_us = div_u64(time_us * 100, bench.speed);
+	at = ktime_add_us(start, time_us);
+	if (ktime_to_ns(ktime_sub(at, ktime_get())) <= 0)
+		return;
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&at, HRTIMER_MODE_ABS);
+}
+
+/**
+ * struct bench_worker - a replaying thread
+ * @bdev:	device to replay on
+ * @first:	index of the first request of the thread
+ * @start:	start time of the run
+ * @skipped:	requests that could not be issued
+ * @done:	signaled once all requests of the thread were issued
+ */
+struct bench_worker {
+	struct block_device *bdev;
+	unsigned int first;
+	ktime_t start;
+	unsigned int skipped;
+	struct completion done;
+};
+
+/* Issues every bench.threads-th request, starting at w->first */
+static void bench_replay(struct bench_worker *w)
+{
+	unsigned int depth = max_t(u32, bench.depth, 1);
+	unsigned int step = max_t(u32, bench.threads, 1);
+	u64 first_us = bench.reqs[0].time_us;
+	struct bench_req *req;
+	struct bio *bio;
+	unsigned int i;
+	int rw;
+
+	for (i = w->first; i < bench.nr_reqs; i += step) {
+		req = &bench.reqs[i];
+		req->bytes = 0;
+		req->lat_us = 0;
+		req->err = 0;
+		req->skipped = false;
+
+		bench_wait_issue_time(w->start, req->time_us > first_us ?
+				      req->time_us - first_us : 0);
+		wait_event(bench.wait,
+			   atomic_read(&bench.inflight) < depth);
+
+		bio = bench_build_bio(w->bdev, req, &rw);
+		if (!bio) {
+			req->skipped = true;
+			w->skipped++;
+			continue;
+		}
+
+		bio->bi_bdev = w->bdev;
+		bio->bi_end_io = bench_end_io;
+		bio->bi_private = req;
+		req->bytes = bio->bi_size;
+		req->start = ktime_get();
+		atomic_inc(&bench.inflight);
+		submit_bio(rw, bio);
+	}
+}
+
+static int bench_worker_fn(void *data)
+{
+	struct bench_worker *w = data;
+
+	bench_replay(w);
+	complete(&w->done);
+
+	return 0;
+}
+
+static int bench_run(struct block_device *bdev)
+{
+	struct request_queue *q = bdev_get_queue(bdev);
+	struct bench_worker *workers, *w;
+	struct task_struct *task;
+	unsigned int t, threads;
+	ktime_t start;
+
+	if (!bench.nr_reqs)
+		return -ENODATA;
+
+	bench.threads = clamp_t(u32, bench.threads, 1, BENCH_MAX_THREADS);
+	threads = bench.threads;
+	workers = kcalloc(threads, sizeof(*workers), GFP_KERNEL);
+	if (!workers)
+		return -ENOMEM;
+
+	bdevname(bdev, bench.dev_name);
+	strlcpy(bench.elv_name, q->elevator ?
+		q->elevator->type->elevator_name : "none", ELV_NAME_MAX);
+
+	bench_pr_info("replaying %u requests on %s (%s), %u threads",
+		      bench.nr_reqs, bench.dev_name, bench.elv_name, threads);
+
+	start = ktime_get();
+	for (t = 0; t < threads; t++) {
+		w = &workers[t];
+		w->bdev = bdev;
+		w->first = t;
+		w->start = start;
+		init_completion(&w->done);
+
+		if (threads == 1) {
+			bench_worker_fn(w);
+			break;
+		}
+
+		task = kthread_run(bench_worker_fn, w, MODULE_NAME "/%u", t);
+		/* Replay that part from here instead */
+		if (IS_ERR(task))
+			bench_worker_fn(w);
+	}
+
+	bench.skipped = 0;
+	for (t = 0; t < threads; t++) {
+		wait_for_completion(&workers[t].done);
+		bench.skipped += workers[t].skipped;
+	}
+	bench.submit_us = ktime_us_delta(ktime_get(), start);
+
+	wait_event(bench.wait, !atomic_read(&bench.inflight));
+	bench.elapsed_us = ktime_us_delta(ktime_get(), start);
+
+	kfree(workers);
+	return 0;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct block_device *bdev;
+	char path[BENCH_MAX_LINE];
+	size_t len = min(count, sizeof(path) - 1);
+	int ret;
+
+	if (copy_from_user(path, buf, len))
+		return -EFAULT;
+	path[len] = '\0';
+
+	bdev = blkdev_get_by_path(strim(path), BENCH_MODE, &bench);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	mutex_lock(&bench.lock);
+	ret = bench_run(bdev);
+	mutex_unlock(&bench.lock);
+
+	blkdev_put(bdev, BENCH_MODE);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.owner		= THIS_MODULE,
+	.open		= nonseekable_open,
+	.write		= bench_run_write,
+	.llseek		= no_llseek,
+};
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_show_op(struct seq_file *s, int op, u32 *lat)
+{
+	unsigned int i, n = 0;
+	u64 bytes = 0, iops, kbps;
+
+	for (i = 0; i < bench.nr_reqs; i++) {
+		struct bench_req *req = &bench.reqs[i];
+
+		if (req->op != op || req->skipped)
+			continue;
+		bytes += req->bytes;
+		lat[n++] = req->lat_us;
+	}
+	if (!n)
+		return;
+
+	sort(lat, n, sizeof(u32), bench_cmp_u32, NULL);
+	iops = div64_u64((u64)n * USEC_PER_SEC, bench.elapsed_us);
+	kbps = div64_u64(bytes * USEC_PER_SEC / 1024, bench.elapsed_us);
+
+	seq_printf(s, "%-8s %8u %9llu %7llu %8u %8u %8u %8u\n",
+		   bench_op_name[op], n, kbps, iops, lat[n * 50 / 100],
+		   lat[n * 90 / 100], lat[n * 99 / 100], lat[n - 1]);
+}
+
+/* Jain's index of the mean latency of the streams, times 1000 */
+static unsigned int bench_fairness(void)
+{
+	/* Protected by bench.lock */
+	static u64 sum[BENCH_MAX_STREAMS];
+	static u32 cnt[BENCH_MAX_STREAMS];
+	u64 mean = 0, meansq = 0, x;
+	unsigned int i, n = 0;
+
+	memset(sum, 0, sizeof(sum));
+	memset(cnt, 0, sizeof(cnt));
+
+	for (i = 0; i < bench.nr_reqs; i++) {
+		struct bench_req *req = &bench.reqs[i];
+
+		if (req->skipped)
+			continue;
+		sum[req->stream] += req->lat_us;
+		cnt[req->stream]++;
+	}
+
+	for (i = 0; i < bench.nr_pids; i++) {
+		if (!cnt[i])
+			continue;
+		x = div_u64(sum[i], cnt[i]);
+		mean += x;
+		meansq += x * x;
+		n++;
+	}
+	if (!n || !meansq)
+		return 1000;
+
+	mean = div_u64(mean, n);
+	meansq = div_u64(meansq, n);
+
+	/* Keep mean * mean * 1000 in range; meansq >= mean * mean */
+	while (mean >= 1ULL << 27) {
+		mean >>= 1;
+		meansq >>= 2;
+	}
+	return div64_u64(mean * mean * 1000, meansq);
+}
+
+static int bench_result_show(struct seq_file *s, void *unused)
+{
+	u32 *lat;
+	int op;
+
+	mutex_lock(&bench.lock);
+	if (!bench.elapsed_us) {
+		seq_puts(s, "no results\n");
+		goto out;
+	}
+
+	lat = vmalloc(bench.nr_reqs * sizeof(*lat));
+	if (!lat) {
+		mutex_unlock(&bench.lock);
+		return -ENOMEM;
+	}
+
+	seq_printf(s, "device %s elevator %s\n", bench.dev_name,
+		   bench.elv_name);
+	seq_printf(s, "requests %u skipped %u streams %d elapsed %llu us\n",
+		   bench.nr_reqs, bench.skipped, bench.nr_pids,
+		   bench.elapsed_us);
+	seq_printf(s, "threads %u submitted in %llu us (%llu req/s)\n",
+		   bench.threads, bench.submit_us,
+		   div64_u64((u64)bench.nr_reqs * USEC_PER_SEC,
+			     max_t(u64, bench.submit_us, 1)));
+	seq_printf(s, "fairness %u/1000\n", bench_fairness());
+	seq_printf(s, "%-8s %8s %9s %7s %8s %8s %8s %8s\n", "op", "count",
+		   "KB/s", "iops", "p50 us", "p90 us", "p99 us", "max us");
+	for (op = 0; op < BENCH_NR_OPS; op++)
+		bench_show_op(s, op, lat);
+
+	vfree(lat);
+out:
+	mutex_unlock(&bench.lock);
+	return 0;
+}
+
+static int bench_result_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_result_show, NULL);
+}
+
+static const struct file_operations bench_result_fops = {
+	.owner		= THIS_MODULE,
+	.open		= bench_result_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int bench_debugfs_init(void)
+{
+	bench_debug_root = debugfs_create_dir(MODULE_NAME, NULL);
+	if (!bench_debug_root)
+		return -ENOENT;
+
+	if (!debugfs_create_file("trace", S_IWUSR, bench_debug_root, NULL,
+				 &bench_trace_fops) ||
+	    !debugfs_create_file("run", S_IWUSR, bench_debug_root, NULL,
+				 &bench_run_fops) ||
+	    !debugfs_create_file("result", S_IRUGO, bench_debug_root, NULL,
+				 &bench_result_fops) ||
+	    !debugfs_create_u32("depth", S_IRUGO | S_IWUSR, bench_debug_root,
+				&bench.depth) ||
+	    !debugfs_create_u32("speed", S_IRUGO | S_IWUSR, bench_debug_root,
+				&bench.speed) ||
+	    !debugfs_create_u32("threads", S_IRUGO | S_IWUSR, bench_debug_root,
+				&bench.threads))
+		goto err;
+
+	return 0;
+
+err:
+	debugfs_remove_recursive(bench_debug_root);
+	return -ENOENT;
+}
+
+static void bench_free_pages(void)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++)
+		if (bench.pages[i])
+			__free_page(bench.pages[i]);
+}
+
+static int __init bench_init(void)
+{
+	int i, ret;
+
+	mutex_init(&bench.lock);
+	init_waitqueue_head(&bench.wait);
+	atomic_set(&bench.inflight, 0);
+	bench.depth = BENCH_DEF_DEPTH;
+	bench.speed = BENCH_DEF_SPEED;
+	bench.threads = 1;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++) {
+		bench.pages[i] = alloc_page(GFP_KERNEL);
+		if (!bench.pages[i]) {
+			ret = -ENOMEM;
+			goto err;
+		}
+	}
+
+	ret = bench_debugfs_init();
+	if (ret)
+		goto err;
+
+	return 0;
+
+err:
+	bench_free_pages();
+	return ret;
+}
+
+static void __exit bench_exit(void)
+{
+	debugfs_remove_recursive(bench_debug_root);
+	bench_reset_trace();
+	bench_free_pages();
+}
+
+module_init(bench_init);
+module_exit(bench_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("I/O scheduler benchmark");
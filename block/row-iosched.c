@@ -26,6 +26,10 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/rcupdate.h>
+#include <linux/sort.h>
+#include "blk-cgroup.h"
 
 /*
  * enum row_queue_prio - Priorities of the ROW queues
@@ -85,6 +89,39 @@ static const struct row_queue_params row_queues_def[] = {
 #define ROW_IDLE_TIME_MSEC 5
 #define ROW_READ_FREQ_MSEC 20
 
+/*
+ * Default blkio cgroup weights at or above which requests are foreground,
+ * and at or below which they are background, when cgroup classes are
+ * enabled. The root cgroup has a weight of 1000.
+ */
+#define ROW_FG_WEIGHT	BLKIO_WEIGHT_MAX
+#define ROW_BG_WEIGHT	100
+
+/*
+ * Read latency feedback: completion latencies of reads are collected in
+ * windows of up to ROW_LAT_SAMPLES samples or ROW_LAT_WINDOW_MSEC. When
+ * the 90th percentile of a window is above the target, the write budget
+ * is halved (down to ROW_LAT_MIN_BUDGET percent), otherwise it grows back
+ * by ROW_LAT_BUDGET_STEP percent.
+ */
+#define ROW_LAT_SAMPLES		64
+#define ROW_LAT_WINDOW_MSEC	100
+#define ROW_LAT_MIN_BUDGET	10
+#define ROW_LAT_BUDGET_STEP	10
+
+/*
+ * enum row_class - Classes of the tasks issuing requests
+ *
+ * With cgroup_classes enabled, requests of foreground tasks go to the
+ * HIGH queues and requests of background tasks to the LOW ones. Other
+ * requests, and all of them when it is disabled, use the REG queues.
+ */
+enum row_class {
+	ROW_CLASS_FG,
+	ROW_CLASS_REG,
+	ROW_CLASS_BG,
+};
+
 /**
  * struct rowq_idling_data -  parameters for idling on the queue
  * @last_insert_time:	time the last request was inserted
@@ -142,6 +179,34 @@ struct idling_data {
 	struct delayed_work		idle_work;
 };
 
+/**
+ * struct row_lat_data - read latency feedback on the write queues
+ * @target_us:		read latency target (usec), 0 disables throttling
+ * @write_budget:	percentage of their quantum the write queues
+ *			may dispatch in a dispatch cycle
+ * @write_credit:	accumulated budget, in percent of a cycle
+ * @skip_writes:	write queues are skipped in the current cycle
+ * @samples:		read latencies of the current window (usec)
+ * @nr_samples:		number of valid entries in @samples
+ * @window_start:	start of the current window (jiffies)
+ * @p50, @p90, @p99:	read latency percentiles of the last window (usec)
+ *
+ */
+struct row_lat_data {
+	int				target_us;
+	int				write_budget;
+	int				write_credit;
+	bool				skip_writes;
+
+	int				samples[ROW_LAT_SAMPLES];
+	unsigned int			nr_samples;
+	unsigned long			window_start;
+
+	int				p50;
+	int				p90;
+	int				p99;
+};
+
 /**
  * struct row_queue - Per block device rqueue structure
  * @dispatch_queue:	dispatch rqueue
@@ -153,6 +218,11 @@ struct idling_data {
  *			scheduler, nr_reqs[1] holds the number of all WRITE
  *			requests in scheduler
  * @cycle_flags:	used for marking unserved queueus
+ * @cgroup_classes:	classify requests by the blkio cgroup of the
+ *			issuing task
+ * @fg_weight:		min cgroup weight of foreground tasks
+ * @bg_weight:		max cgroup weight of background tasks
+ * @lat:		read latency feedback data
  *
  */
 struct row_data {
@@ -166,9 +236,17 @@ struct row_data {
 	unsigned int			nr_reqs[2];
 
 	unsigned int			cycle_flags;
+
+	int				cgroup_classes;
+	int				fg_weight;
+	int				bg_weight;
+
+	struct row_lat_data		lat;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
+/* Dispatch time of READ requests (usec), for latency feedback */
+#define RQ_DISP_US(rq) ((unsigned long) ((rq)->elv.priv[1]))
 
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
@@ -206,6 +284,45 @@ static inline void __maybe_unused row_dump_queues_stat(struct row_data *rd)
 			rd->row_queues[i].nr_req);
 }
 
+static inline bool row_rowq_is_write(enum row_queue_prio qnum)
+{
+	/* Foreground sync writes are not throttled */
+	return qnum == ROWQ_PRIO_REG_SWRITE || qnum == ROWQ_PRIO_REG_WRITE ||
+		qnum == ROWQ_PRIO_LOW_SWRITE;
+}
+
+/*
+ * row_rowq_throttled() - Check if a queue is skipped in this cycle
+ * @rd:		pointer to struct row_data
+ * @qnum:	queue to check
+ *
+ * Write queues are only skipped while there are reads to dispatch,
+ * so that writes are never stalled on an otherwise idle device.
+ */
+static inline bool row_rowq_throttled(struct row_data *rd,
+				      enum row_queue_prio qnum)
+{
+	return rd->lat.skip_writes && row_rowq_is_write(qnum) &&
+		rd->nr_reqs[READ];
+}
+
+/*
+ * row_rowq_quantum() - Number of requests a queue may dispatch
+ * @rd:		pointer to struct row_data
+ * @qnum:	queue to check
+ *
+ * The quantum of the write queues is scaled by the write budget.
+ */
+static inline int row_rowq_quantum(struct row_data *rd,
+				   enum row_queue_prio qnum)
+{
+	int quantum = rd->row_queues[qnum].disp_quantum;
+
+	if (!row_rowq_is_write(qnum) || rd->lat.write_budget == 100)
+		return quantum;
+	return max(quantum * rd->lat.write_budget / 100, 1);
+}
+
 /******************** Static helper functions ***********************/
 /*
  * kick_queue() - Wake up device driver queue thread
@@ -252,6 +369,15 @@ static inline void row_restart_disp_cycle(struct row_data *rd)
 	for (i = 0; i < ROWQ_MAX_PRIO; i++)
 		rd->row_queues[i].nr_dispatched = 0;
 
+	/*
+	 * Quanta of 1 can't be scaled down, so a budget below 100% also
+	 * makes the write queues sit out some of the cycles.
+	 */
+	rd->lat.write_credit += rd->lat.write_budget;
+	rd->lat.skip_writes = rd->lat.write_credit < 100;
+	if (!rd->lat.skip_writes)
+		rd->lat.write_credit -= 100;
+
 	rd->curr_queue = ROWQ_PRIO_HIGH_READ;
 	row_log(rd->dispatch_queue, "Restarting cycle");
 }
@@ -395,6 +521,9 @@ static void row_dispatch_insert(struct row_data *rd)
 
 	rq = rq_entry_fifo(rd->row_queues[rd->curr_queue].fifo.next);
 	row_remove_request(rd->dispatch_queue, rq);
+	if (rq_data_dir(rq) == READ)
+		rq->elv.priv[1] =
+			(void *)(unsigned long)ktime_to_us(ktime_get());
 	elv_dispatch_add_tail(rd->dispatch_queue, rq);
 	rd->row_queues[rd->curr_queue].nr_dispatched++;
 	row_clear_rowq_unserved(rd, rd->curr_queue);
@@ -425,10 +554,12 @@ static int row_choose_queue(struct row_data *rd)
 	 * Loop over all queues to find the next queue that is not empty.
 	 * Stop when you get back to curr_queue
 	 */
-	while (list_empty(&rd->row_queues[rd->curr_queue].fifo)
+	while ((list_empty(&rd->row_queues[rd->curr_queue].fifo) ||
+		row_rowq_throttled(rd, rd->curr_queue))
 	       && rd->curr_queue != prev_curr_queue) {
-		/* Mark rqueue as unserved */
-		row_mark_rowq_unserved(rd, rd->curr_queue);
+		/* Mark rqueue as unserved, unless skipped on purpose */
+		if (!row_rowq_throttled(rd, rd->curr_queue))
+			row_mark_rowq_unserved(rd, rd->curr_queue);
 		row_get_next_queue(rd);
 	}
 
@@ -457,7 +588,8 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 	 */
 	for (i = 0; i < currq; i++) {
 		if (row_rowq_unserved(rd, i) &&
-		    !list_empty(&rd->row_queues[i].fifo)) {
+		    !list_empty(&rd->row_queues[i].fifo) &&
+		    !row_rowq_throttled(rd, i)) {
 			row_log_rowq(rd, currq,
 				" Preemting for unserved rowq%d. (nr_req=%u)",
 				i, rd->row_queues[currq].nr_req);
@@ -469,7 +601,7 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 	}
 
 	if (rd->row_queues[currq].nr_dispatched >=
-	    rd->row_queues[currq].disp_quantum) {
+	    row_rowq_quantum(rd, currq)) {
 		rd->row_queues[currq].nr_dispatched = 0;
 		row_log_rowq(rd, currq, "Expiring rqueue");
 		ret = row_choose_queue(rd);
@@ -570,6 +702,13 @@ static void *row_init_queue(struct request_queue *q)
 	rdata->curr_queue = ROWQ_PRIO_HIGH_READ;
 	rdata->dispatch_queue = q;
 
+	rdata->cgroup_classes = 0;
+	rdata->fg_weight = ROW_FG_WEIGHT;
+	rdata->bg_weight = ROW_BG_WEIGHT;
+
+	rdata->lat.write_budget = 100;
+	rdata->lat.window_start = jiffies;
+
 	rdata->nr_reqs[READ] = rdata->nr_reqs[WRITE] = 0;
 
 	return rdata;
@@ -593,6 +732,70 @@ static void row_exit_queue(struct elevator_queue *e)
 	kfree(rd);
 }
 
+static int row_lat_cmp(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * row_lat_update() - Close the current latency window
+ * @rd:	pointer to struct row_data
+ *
+ * Updates the percentiles and adjusts the write budget. A window
+ * without reads counts as meeting the target.
+ */
+static void row_lat_update(struct row_data *rd)
+{
+	struct row_lat_data *lat = &rd->lat;
+	unsigned int n = lat->nr_samples;
+
+	if (n) {
+		sort(lat->samples, n, sizeof(int), row_lat_cmp, NULL);
+		lat->p50 = lat->samples[n * 50 / 100];
+		lat->p90 = lat->samples[n * 90 / 100];
+		lat->p99 = lat->samples[n * 99 / 100];
+	}
+
+	if (!lat->target_us)
+		lat->write_budget = 100;
+	else if (n && lat->p90 > lat->target_us)
+		lat->write_budget = max(lat->write_budget / 2,
+					ROW_LAT_MIN_BUDGET);
+	else
+		lat->write_budget = min(lat->write_budget +
+					ROW_LAT_BUDGET_STEP, 100);
+
+	row_log(rd->dispatch_queue, "read lat p90 %dus, write budget %d%%",
+		lat->p90, lat->write_budget);
+
+	lat->nr_samples = 0;
+	lat->window_start = jiffies;
+}
+
+/*
+ * row_completed_request() - Called when a request is completed
+ * @q:	requests queue
+ * @rq:	completed request
+ *
+ * Called with the queue lock held.
+ */
+static void row_completed_request(struct request_queue *q,
+				  struct request *rq)
+{
+	struct row_data *rd = (struct row_data *)q->elevator->elevator_data;
+	struct row_lat_data *lat = &rd->lat;
+	unsigned long now = (unsigned long)ktime_to_us(ktime_get());
+
+	if (rq_data_dir(rq) == READ && RQ_DISP_US(rq))
+		lat->samples[lat->nr_samples++] =
+			min_t(unsigned long, now - RQ_DISP_US(rq), INT_MAX);
+
+	if (lat->nr_samples == ROW_LAT_SAMPLES ||
+	    time_after(jiffies, lat->window_start +
+		       msecs_to_jiffies(ROW_LAT_WINDOW_MSEC)))
+		row_lat_update(rd);
+}
+
 /*
  * row_merged_requests() - Called when 2 requests are merged
  * @q:		requests queue
@@ -610,27 +813,72 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 	rqueue->rdata->nr_reqs[rq_data_dir(rq)]--;
 }
 
+/*
+ * row_get_class() - Get the class of the current task
+ * @rd:	pointer to struct row_data
+ *
+ * Requests are set up in the context of the task issuing them, so the
+ * class is that of its blkio cgroup. Asynchronous writes never get here:
+ * get_queue_type() puts them on REG_WRITE whatever their cgroup.
+ */
+static enum row_class row_get_class(struct row_data *rd)
+{
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_CGROUP_MODULE)
+	struct blkio_cgroup *blkcg;
+	unsigned int weight;
+
+	if (!rd->cgroup_classes)
+		return ROW_CLASS_REG;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	weight = blkcg->weight;
+	rcu_read_unlock();
+
+	if (weight >= rd->fg_weight)
+		return ROW_CLASS_FG;
+	if (weight <= rd->bg_weight)
+		return ROW_CLASS_BG;
+#endif
+	return ROW_CLASS_REG;
+}
+
 /*
  * get_queue_type() - Get queue type for a given request
+ * @rd:	pointer to struct row_data
+ * @rq:	the request
  *
  * This is a helping function which purpose is to determine what
  * ROW queue the given request should be added to (and
  * dispatched from leter on)
  *
- * TODO: Right now only 3 queues are used REG_READ, REG_WRITE
- * and REG_SWRITE
+ * Asynchronous writes always use REG_WRITE, since they are issued on
+ * behalf of whoever dirtied the pages.
  */
-static enum row_queue_prio get_queue_type(struct request *rq)
+static enum row_queue_prio get_queue_type(struct row_data *rd,
+					  struct request *rq)
 {
 	const int data_dir = rq_data_dir(rq);
 	const bool is_sync = rq_is_sync(rq);
+	enum row_class class;
 
-	if (data_dir == READ)
-		return ROWQ_PRIO_REG_READ;
-	else if (is_sync)
-		return ROWQ_PRIO_REG_SWRITE;
-	else
+	if (data_dir == WRITE && !is_sync)
 		return ROWQ_PRIO_REG_WRITE;
+
+	class = row_get_class(rd);
+	if (data_dir == READ) {
+		if (class == ROW_CLASS_FG)
+			return ROWQ_PRIO_HIGH_READ;
+		if (class == ROW_CLASS_BG)
+			return ROWQ_PRIO_LOW_READ;
+		return ROWQ_PRIO_REG_READ;
+	}
+
+	if (class == ROW_CLASS_FG)
+		return ROWQ_PRIO_HIGH_SWRITE;
+	if (class == ROW_CLASS_BG)
+		return ROWQ_PRIO_LOW_SWRITE;
+	return ROWQ_PRIO_REG_SWRITE;
 }
 
 /*
@@ -648,7 +896,7 @@ row_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
 
 	spin_lock_irqsave(q->queue_lock, flags);
 	rq->elv.priv[0] =
-		(void *)(&rd->row_queues[get_queue_type(rq)]);
+		(void *)(&rd->row_queues[get_queue_type(rd, rq)]);
 	spin_unlock_irqrestore(q->queue_lock, flags);
 
 	return 0;
@@ -693,6 +941,14 @@ SHOW_FUNCTION(row_lp_swrite_quantum_show,
 	rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum, 0);
 SHOW_FUNCTION(row_read_idle_show, rowd->read_idle.idle_time, 0);
 SHOW_FUNCTION(row_read_idle_freq_show, rowd->read_idle.freq, 0);
+SHOW_FUNCTION(row_cgroup_classes_show, rowd->cgroup_classes, 0);
+SHOW_FUNCTION(row_fg_weight_show, rowd->fg_weight, 0);
+SHOW_FUNCTION(row_bg_weight_show, rowd->bg_weight, 0);
+SHOW_FUNCTION(row_read_lat_target_us_show, rowd->lat.target_us, 0);
+SHOW_FUNCTION(row_write_budget_show, rowd->lat.write_budget, 0);
+SHOW_FUNCTION(row_read_lat_p50_show, rowd->lat.p50, 0);
+SHOW_FUNCTION(row_read_lat_p90_show, rowd->lat.p90, 0);
+SHOW_FUNCTION(row_read_lat_p99_show, rowd->lat.p99, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -733,12 +989,21 @@ STORE_FUNCTION(row_lp_swrite_quantum_store,
 			1, INT_MAX, 1);
 STORE_FUNCTION(row_read_idle_store, &rowd->read_idle.idle_time, 1, INT_MAX, 0);
 STORE_FUNCTION(row_read_idle_freq_store, &rowd->read_idle.freq, 1, INT_MAX, 0);
+STORE_FUNCTION(row_cgroup_classes_store, &rowd->cgroup_classes, 0, 1, 0);
+STORE_FUNCTION(row_fg_weight_store, &rowd->fg_weight, BLKIO_WEIGHT_MIN,
+			BLKIO_WEIGHT_MAX, 0);
+STORE_FUNCTION(row_bg_weight_store, &rowd->bg_weight, BLKIO_WEIGHT_MIN,
+			BLKIO_WEIGHT_MAX, 0);
+STORE_FUNCTION(row_read_lat_target_us_store, &rowd->lat.target_us, 0,
+			INT_MAX, 0);
 
 #undef STORE_FUNCTION
 
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
+#define ROW_ATTR_RO(name) \
+	__ATTR(name, S_IRUGO, row_##name##_show, NULL)
 
 static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(hp_read_quantum),
@@ -750,6 +1015,14 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(lp_swrite_quantum),
 	ROW_ATTR(read_idle),
 	ROW_ATTR(read_idle_freq),
+	ROW_ATTR(cgroup_classes),
+	ROW_ATTR(fg_weight),
+	ROW_ATTR(bg_weight),
+	ROW_ATTR(read_lat_target_us),
+	ROW_ATTR_RO(write_budget),
+	ROW_ATTR_RO(read_lat_p50),
+	ROW_ATTR_RO(read_lat_p90),
+	ROW_ATTR_RO(read_lat_p99),
 	__ATTR_NULL
 };
 
@@ -757,6 +1030,7 @@ static struct elevator_type iosched_row = {
 	.ops = {
 		.elevator_merge_req_fn		= row_merged_requests,
 		.elevator_dispatch_fn		= row_dispatch_requests,
+		.elevator_completed_req_fn	= row_completed_request,
 		.elevator_add_req_fn		= row_add_request,
 		.elevator_reinsert_req_fn	= row_reinsert_req,
 		.elevator_is_urgent_fn		= row_urgent_pending,
@@ -380,17 +380,20 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
 	ktime_t calltime;
+	u64 start;
 	int error;
 
 	if (!cb)
 		return 0;
 
 	calltime = initcall_debug_start(dev);
+	start = suspend_time_device_begin();
 
 	pm_dev_dbg(dev, state, info);
 	error = cb(dev);
 	suspend_report_result(cb, error);
 
+	suspend_time_device_end(dev, start);
 	initcall_debug_report(dev, calltime, error);
 
 	return error;
@@ -1034,12 +1037,16 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 {
 	int error;
 	ktime_t calltime;
+	u64 start;
 
 	calltime = initcall_debug_start(dev);
+	start = suspend_time_device_begin();
 
 	error = cb(dev, state);
 	suspend_report_result(cb, error);
 
+	suspend_time_device_end(dev, start);
+
 	initcall_debug_report(dev, calltime, error);
 
 	return error;
@@ -37,58 +37,22 @@
 
 static int active_count;
 
-struct cpufreq_interactive_cpuinfo {
-	struct timer_list cpu_timer;
-	struct timer_list cpu_slack_timer;
-	spinlock_t load_lock; /* protects the next 4 fields */
-	u64 time_in_idle;
-	u64 time_in_idle_timestamp;
-	u64 cputime_speedadj;
-	u64 cputime_speedadj_timestamp;
-	struct cpufreq_policy *policy;
-	struct cpufreq_frequency_table *freq_table;
-	unsigned int target_freq;
-	unsigned int floor_freq;
-	u64 floor_validate_time;
-	u64 hispeed_validate_time;
-	struct rw_semaphore enable_sem;
-	int governor_enabled;
-	int cpu_load;
-};
-
-static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
-
-/* realtime thread handles frequency scaling */
-static struct task_struct *speedchange_task;
-static cpumask_t speedchange_cpumask;
-static spinlock_t speedchange_cpumask_lock;
-static struct mutex gov_lock;
-
-/* Hi speed to bump to from lo speed when load burst (default max) */
-static unsigned int hispeed_freq;
-
 /* Go to hi speed when CPU load at or above this value. */
 #define DEFAULT_GO_HISPEED_LOAD 99
-static unsigned long go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
 
 /* Target load.  Lower values result in higher CPU speeds. */
 #define DEFAULT_TARGET_LOAD 90
 static unsigned int default_target_loads[] = {DEFAULT_TARGET_LOAD};
-static spinlock_t target_loads_lock;
-static unsigned int *target_loads = default_target_loads;
-static int ntarget_loads = ARRAY_SIZE(default_target_loads);
 
 /*
  * The minimum amount of time to spend at a frequency before we can ramp down.
  */
 #define DEFAULT_MIN_SAMPLE_TIME (80 * USEC_PER_MSEC)
-static unsigned long min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
 
 /*
  * The sample rate of the timer used to increase frequency
  */
 #define DEFAULT_TIMER_RATE (20 * USEC_PER_MSEC)
-static unsigned long timer_rate = DEFAULT_TIMER_RATE;
 
 /*
  * Wait this long before raising speed above hispeed, by default a single
@@ -97,25 +61,89 @@ static unsigned long timer_rate = DEFAULT_TIMER_RATE;
 #define DEFAULT_ABOVE_HISPEED_DELAY DEFAULT_TIMER_RATE
 static unsigned int default_above_hispeed_delay[] = {
 	DEFAULT_ABOVE_HISPEED_DELAY };
-static spinlock_t above_hispeed_delay_lock;
-static unsigned int *above_hispeed_delay = default_above_hispeed_delay;
-static int nabove_hispeed_delay = ARRAY_SIZE(default_above_hispeed_delay);
-
-/* Non-zero means indefinite speed boost active */
-static int boost_val;
-/* Duration of a boot pulse in usecs */
-static int boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
-/* End time of boost pulse in ktime converted to usecs */
-static u64 boostpulse_endtime;
 
 /*
  * Max additional time to wait in idle, beyond timer_rate, at speeds above
  * minimum before wakeup to reduce speed, or -1 if unnecessary.
  */
 #define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
-static int timer_slack_val = DEFAULT_TIMER_SLACK;
 
-static bool io_is_busy;
+/*
+ * A governor instance, with its own tunables and speed change thread, is
+ * created the first time the governor is started on a policy. It is kept
+ * when the governor is stopped, so that the tunables survive hotplug, and
+ * is shared by all the CPUs of the policy. The global tunables apply to
+ * every instance; with the per_policy parameter set, the tunables of each
+ * instance are also exposed under the "interactive" directory of its
+ * policy.
+ */
+struct cpufreq_interactive_policyinfo {
+	struct list_head list;
+	struct kobject *kobj;
+
+	/* realtime thread handles frequency scaling */
+	struct task_struct *speedchange_task;
+	cpumask_t speedchange_cpumask;
+	spinlock_t speedchange_cpumask_lock;
+
+	/* Hi speed to bump to from lo speed when load burst (default max) */
+	unsigned int hispeed_freq;
+	unsigned long go_hispeed_load;
+	spinlock_t target_loads_lock;
+	unsigned int *target_loads;
+	int ntarget_loads;
+	unsigned long min_sample_time;
+	unsigned long timer_rate;
+	spinlock_t above_hispeed_delay_lock;
+	unsigned int *above_hispeed_delay;
+	int nabove_hispeed_delay;
+	/* Non-zero means indefinite speed boost active */
+	int boost_val;
+	/* Duration of a boot pulse in usecs */
+	int boostpulse_duration_val;
+	/* End time of boost pulse in ktime converted to usecs */
+	u64 boostpulse_endtime;
+	int timer_slack_val;
+	bool io_is_busy;
+	/* Use the scheduler's decayed busy time instead of idle time */
+	bool use_sched_load;
+};
+
+struct cpufreq_interactive_cpuinfo {
+	struct timer_list cpu_timer;
+	struct timer_list cpu_slack_timer;
+	spinlock_t load_lock; /* protects the next 4 fields */
+	u64 time_in_idle;
+	u64 time_in_idle_timestamp;
+	u64 cputime_speedadj;
+	u64 cputime_speedadj_timestamp;
+	struct cpufreq_policy *policy;
+	struct cpufreq_interactive_policyinfo *ppol;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int target_freq;
+	unsigned int floor_freq;
+	u64 floor_validate_time;
+	u64 hispeed_validate_time;
+	struct rw_semaphore enable_sem;
+	int governor_enabled;
+	int cpu_load;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
+
+static struct mutex gov_lock;
+
+/*
+ * All governor instances, for the global tunables. Those are kept in
+ * global_tunables too, which new instances start from.
+ */
+static LIST_HEAD(policyinfo_list);
+static DEFINE_MUTEX(policyinfo_list_lock);
+static struct cpufreq_interactive_policyinfo global_tunables;
+
+static bool per_policy;
+module_param(per_policy, bool, 0444);
+MODULE_PARM_DESC(per_policy, "Expose the tunables of each policy");
 
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
@@ -154,7 +182,7 @@ static inline cputime64_t get_cpu_idle_time_jiffy(unsigned int cpu,
 }
 
 static inline cputime64_t get_cpu_idle_time(unsigned int cpu,
-					    cputime64_t *wall)
+					    cputime64_t *wall, bool io_is_busy)
 {
 	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
 
@@ -169,20 +197,23 @@ static inline cputime64_t get_cpu_idle_time(unsigned int cpu,
 static void cpufreq_interactive_timer_resched(
 	struct cpufreq_interactive_cpuinfo *pcpu)
 {
+	struct cpufreq_interactive_policyinfo *ppol = pcpu->ppol;
 	unsigned long expires;
 	unsigned long flags;
 
 	spin_lock_irqsave(&pcpu->load_lock, flags);
 	pcpu->time_in_idle =
 		get_cpu_idle_time(smp_processor_id(),
-				     &pcpu->time_in_idle_timestamp);
+				  &pcpu->time_in_idle_timestamp,
+				  ppol->io_is_busy);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
-	expires = jiffies + usecs_to_jiffies(timer_rate);
+	expires = jiffies + usecs_to_jiffies(ppol->timer_rate);
 	mod_timer_pinned(&pcpu->cpu_timer, expires);
 
-	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
-		expires += usecs_to_jiffies(timer_slack_val);
+	if (ppol->timer_slack_val >= 0 &&
+	    pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(ppol->timer_slack_val);
 		mod_timer_pinned(&pcpu->cpu_slack_timer, expires);
 	}
 
@@ -196,55 +227,61 @@ static void cpufreq_interactive_timer_resched(
 static void cpufreq_interactive_timer_start(int cpu)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
-	unsigned long expires = jiffies + usecs_to_jiffies(timer_rate);
+	struct cpufreq_interactive_policyinfo *ppol = pcpu->ppol;
+	unsigned long expires = jiffies + usecs_to_jiffies(ppol->timer_rate);
 	unsigned long flags;
 
 	pcpu->cpu_timer.expires = expires;
 	add_timer_on(&pcpu->cpu_timer, cpu);
-	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
-		expires += usecs_to_jiffies(timer_slack_val);
+	if (ppol->timer_slack_val >= 0 &&
+	    pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(ppol->timer_slack_val);
 		pcpu->cpu_slack_timer.expires = expires;
 		add_timer_on(&pcpu->cpu_slack_timer, cpu);
 	}
 
 	spin_lock_irqsave(&pcpu->load_lock, flags);
 	pcpu->time_in_idle =
-		get_cpu_idle_time(cpu, &pcpu->time_in_idle_timestamp);
+		get_cpu_idle_time(cpu, &pcpu->time_in_idle_timestamp,
+				  ppol->io_is_busy);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
 	spin_unlock_irqrestore(&pcpu->load_lock, flags);
 }
 
-static unsigned int freq_to_above_hispeed_delay(unsigned int freq)
+static unsigned int freq_to_above_hispeed_delay(
+	struct cpufreq_interactive_policyinfo *ppol, unsigned int freq)
 {
 	int i;
 	unsigned int ret;
 	unsigned long flags;
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&ppol->above_hispeed_delay_lock, flags);
 
-	for (i = 0; i < nabove_hispeed_delay - 1 &&
-			freq >= above_hispeed_delay[i+1]; i += 2)
+	for (i = 0; i < ppol->nabove_hispeed_delay - 1 &&
+			freq >= ppol->above_hispeed_delay[i+1]; i += 2)
 		;
 
-	ret = above_hispeed_delay[i];
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	ret = ppol->above_hispeed_delay[i];
+	spin_unlock_irqrestore(&ppol->above_hispeed_delay_lock, flags);
 	return ret;
 }
 
-static unsigned int freq_to_targetload(unsigned int freq)
+static unsigned int freq_to_targetload(
+	struct cpufreq_interactive_policyinfo *ppol, unsigned int freq)
 {
 	int i;
 	unsigned int ret;
 	unsigned long flags;
 
-	spin_lock_irqsave(&target_loads_lock, flags);
+	spin_lock_irqsave(&ppol->target_loads_lock, flags);
 
-	for (i = 0; i < ntarget_loads - 1 && freq >= target_loads[i+1]; i += 2)
+	for (i = 0; i < ppol->ntarget_loads - 1 &&
+		    freq >= ppol->target_loads[i+1]; i += 2)
 		;
 
-	ret = target_loads[i];
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	ret = ppol->target_loads[i];
+	spin_unlock_irqrestore(&ppol->target_loads_lock, flags);
 	return ret;
 }
 
@@ -267,7 +304,7 @@ static unsigned int choose_freq(
 
 	do {
 		prevfreq = freq;
-		tl = freq_to_targetload(freq);
+		tl = freq_to_targetload(pcpu->ppol, freq);
 
 		/*
 		 * Find the lowest frequency where the computed load is less
@@ -348,7 +385,7 @@ static u64 update_load(int cpu)
 	unsigned int delta_time;
 	u64 active_time;
 
-	now_idle = get_cpu_idle_time(cpu, &now);
+	now_idle = get_cpu_idle_time(cpu, &now, pcpu->ppol->io_is_busy);
 	delta_idle = (unsigned int)(now_idle - pcpu->time_in_idle);
 	delta_time = (unsigned int)(now - pcpu->time_in_idle_timestamp);
 
@@ -372,6 +409,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	int cpu_load;
 	struct cpufreq_interactive_cpuinfo *pcpu =
 		&per_cpu(cpuinfo, data);
+	struct cpufreq_interactive_policyinfo *ppol;
 	unsigned int new_freq;
 	unsigned int loadadjfreq;
 	unsigned int index;
@@ -383,6 +421,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (!pcpu->governor_enabled)
 		goto exit;
 
+	ppol = pcpu->ppol;
 	spin_lock_irqsave(&pcpu->load_lock, flags);
 	now = update_load(data);
 	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
@@ -393,29 +432,33 @@ static void cpufreq_interactive_timer(unsigned long data)
 		goto rearm;
 
 	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	if (ppol->use_sched_load)
+		loadadjfreq = ((sched_get_cpu_util(data) * 100) >>
+			       SCHED_UTIL_SHIFT) * pcpu->policy->cur;
+	else
+		loadadjfreq = (unsigned int)cputime_speedadj * 100;
 	cpu_load = loadadjfreq / pcpu->target_freq;
-	boosted = boost_val || now < boostpulse_endtime;
+	boosted = ppol->boost_val || now < ppol->boostpulse_endtime;
 
 	pcpu->cpu_load = cpu_load;
 
-	if (cpu_load >= go_hispeed_load || boosted) {
-		if (pcpu->target_freq < hispeed_freq) {
-			new_freq = hispeed_freq;
+	if (cpu_load >= ppol->go_hispeed_load || boosted) {
+		if (pcpu->target_freq < ppol->hispeed_freq) {
+			new_freq = ppol->hispeed_freq;
 		} else {
 			new_freq = choose_freq(pcpu, loadadjfreq);
 
-			if (new_freq < hispeed_freq)
-				new_freq = hispeed_freq;
+			if (new_freq < ppol->hispeed_freq)
+				new_freq = ppol->hispeed_freq;
 		}
 	} else {
 		new_freq = choose_freq(pcpu, loadadjfreq);
 	}
 
-	if (pcpu->target_freq >= hispeed_freq &&
+	if (pcpu->target_freq >= ppol->hispeed_freq &&
 	    new_freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time <
-	    freq_to_above_hispeed_delay(pcpu->target_freq)) {
+	    freq_to_above_hispeed_delay(ppol, pcpu->target_freq)) {
 		trace_cpufreq_interactive_notyet(
 			data, cpu_load, pcpu->target_freq,
 			pcpu->policy->cur, new_freq);
@@ -436,7 +479,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 * floor frequency for the minimum sample time since last validated.
 	 */
 	if (new_freq < pcpu->floor_freq) {
-		if (now - pcpu->floor_validate_time < min_sample_time) {
+		if (now - pcpu->floor_validate_time <
+		    ppol->min_sample_time) {
 			trace_cpufreq_interactive_notyet(
 				data, cpu_load, pcpu->target_freq,
 				pcpu->policy->cur, new_freq);
@@ -452,7 +496,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 * (or the indefinite boost is turned off).
 	 */
 
-	if (!boosted || new_freq > hispeed_freq) {
+	if (!boosted || new_freq > ppol->hispeed_freq) {
 		pcpu->floor_freq = new_freq;
 		pcpu->floor_validate_time = now;
 	}
@@ -468,10 +512,10 @@ static void cpufreq_interactive_timer(unsigned long data)
 					 pcpu->policy->cur, new_freq);
 
 	pcpu->target_freq = new_freq;
-	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
-	cpumask_set_cpu(data, &speedchange_cpumask);
-	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
-	wake_up_process(speedchange_task);
+	spin_lock_irqsave(&ppol->speedchange_cpumask_lock, flags);
+	cpumask_set_cpu(data, &ppol->speedchange_cpumask);
+	spin_unlock_irqrestore(&ppol->speedchange_cpumask_lock, flags);
+	wake_up_process(ppol->speedchange_task);
 
 rearm_if_notmax:
 	/*
@@ -547,6 +591,7 @@ static void cpufreq_interactive_idle_end(void)
 
 static int cpufreq_interactive_speedchange_task(void *data)
 {
+	struct cpufreq_interactive_policyinfo *ppol = data;
 	unsigned int cpu;
 	cpumask_t tmp_mask;
 	unsigned long flags;
@@ -554,23 +599,24 @@ static int cpufreq_interactive_speedchange_task(void *data)
 
 	while (1) {
 		set_current_state(TASK_INTERRUPTIBLE);
-		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		spin_lock_irqsave(&ppol->speedchange_cpumask_lock, flags);
 
-		if (cpumask_empty(&speedchange_cpumask)) {
-			spin_unlock_irqrestore(&speedchange_cpumask_lock,
-					       flags);
+		if (cpumask_empty(&ppol->speedchange_cpumask)) {
+			spin_unlock_irqrestore(
+				&ppol->speedchange_cpumask_lock, flags);
 			schedule();
 
 			if (kthread_should_stop())
 				break;
 
-			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+			spin_lock_irqsave(&ppol->speedchange_cpumask_lock,
+					  flags);
 		}
 
 		set_current_state(TASK_RUNNING);
-		tmp_mask = speedchange_cpumask;
-		cpumask_clear(&speedchange_cpumask);
-		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+		tmp_mask = ppol->speedchange_cpumask;
+		cpumask_clear(&ppol->speedchange_cpumask);
+		spin_unlock_irqrestore(&ppol->speedchange_cpumask_lock, flags);
 
 		for_each_cpu(cpu, &tmp_mask) {
 			unsigned int j;
@@ -609,21 +655,24 @@ static int cpufreq_interactive_speedchange_task(void *data)
 	return 0;
 }
 
-static void cpufreq_interactive_boost(void)
+static void cpufreq_interactive_boost(
+	struct cpufreq_interactive_policyinfo *ppol)
 {
 	int i;
 	int anyboost = 0;
 	unsigned long flags;
 	struct cpufreq_interactive_cpuinfo *pcpu;
 
-	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	spin_lock_irqsave(&ppol->speedchange_cpumask_lock, flags);
 
 	for_each_online_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
+		if (pcpu->ppol != ppol)
+			continue;
 
-		if (pcpu->target_freq < hispeed_freq) {
-			pcpu->target_freq = hispeed_freq;
-			cpumask_set_cpu(i, &speedchange_cpumask);
+		if (pcpu->target_freq < ppol->hispeed_freq) {
+			pcpu->target_freq = ppol->hispeed_freq;
+			cpumask_set_cpu(i, &ppol->speedchange_cpumask);
 			pcpu->hispeed_validate_time =
 				ktime_to_us(ktime_get());
 			anyboost = 1;
@@ -634,14 +683,14 @@ static void cpufreq_interactive_boost(void)
 		 * validated.
 		 */
 
-		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_freq = ppol->hispeed_freq;
 		pcpu->floor_validate_time = ktime_to_us(ktime_get());
 	}
 
-	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+	spin_unlock_irqrestore(&ppol->speedchange_cpumask_lock, flags);
 
 	if (anyboost)
-		wake_up_process(speedchange_task);
+		wake_up_process(ppol->speedchange_task);
 }
 
 static int cpufreq_interactive_notifier(
@@ -733,26 +782,36 @@ err:
 	return ERR_PTR(err);
 }
 
+/* Instance of the policy the "interactive" directory kobj belongs to */
+static struct cpufreq_interactive_policyinfo *to_policyinfo(
+	struct kobject *kobj)
+{
+	struct cpufreq_policy *policy =
+		container_of(kobj->parent, struct cpufreq_policy, kobj);
+
+	return per_cpu(cpuinfo, policy->cpu).ppol;
+}
+
 static ssize_t show_target_loads(
-	struct kobject *kobj, struct attribute *attr, char *buf)
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
 	int i;
 	ssize_t ret = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&target_loads_lock, flags);
+	spin_lock_irqsave(&ppol->target_loads_lock, flags);
 
-	for (i = 0; i < ntarget_loads; i++)
-		ret += sprintf(buf + ret, "%u%s", target_loads[i],
+	for (i = 0; i < ppol->ntarget_loads; i++)
+		ret += sprintf(buf + ret, "%u%s", ppol->target_loads[i],
 			       i & 0x1 ? ":" : " ");
 
 	ret += sprintf(buf + ret, "\n");
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	spin_unlock_irqrestore(&ppol->target_loads_lock, flags);
 	return ret;
 }
 
 static ssize_t store_target_loads(
-	struct kobject *kobj, struct attribute *attr, const char *buf,
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
 	size_t count)
 {
 	int ntokens;
@@ -763,39 +822,36 @@ static ssize_t store_target_loads(
 	if (IS_ERR(new_target_loads))
 		return PTR_RET(new_target_loads);
 
-	spin_lock_irqsave(&target_loads_lock, flags);
-	if (target_loads != default_target_loads)
-		kfree(target_loads);
-	target_loads = new_target_loads;
-	ntarget_loads = ntokens;
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	spin_lock_irqsave(&ppol->target_loads_lock, flags);
+	if (ppol->target_loads != default_target_loads)
+		kfree(ppol->target_loads);
+	ppol->target_loads = new_target_loads;
+	ppol->ntarget_loads = ntokens;
+	spin_unlock_irqrestore(&ppol->target_loads_lock, flags);
 	return count;
 }
 
-static struct global_attr target_loads_attr =
-	__ATTR(target_loads, S_IRUGO | S_IWUSR,
-		show_target_loads, store_target_loads);
-
 static ssize_t show_above_hispeed_delay(
-	struct kobject *kobj, struct attribute *attr, char *buf)
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
 	int i;
 	ssize_t ret = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&ppol->above_hispeed_delay_lock, flags);
 
-	for (i = 0; i < nabove_hispeed_delay; i++)
-		ret += sprintf(buf + ret, "%u%s", above_hispeed_delay[i],
+	for (i = 0; i < ppol->nabove_hispeed_delay; i++)
+		ret += sprintf(buf + ret, "%u%s",
+			       ppol->above_hispeed_delay[i],
 			       i & 0x1 ? ":" : " ");
 
 	ret += sprintf(buf + ret, "\n");
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_unlock_irqrestore(&ppol->above_hispeed_delay_lock, flags);
 	return ret;
 }
 
 static ssize_t store_above_hispeed_delay(
-	struct kobject *kobj, struct attribute *attr, const char *buf,
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
 	size_t count)
 {
 	int ntokens;
@@ -806,29 +862,25 @@ static ssize_t store_above_hispeed_delay(
 	if (IS_ERR(new_above_hispeed_delay))
 		return PTR_RET(new_above_hispeed_delay);
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
-	if (above_hispeed_delay != default_above_hispeed_delay)
-		kfree(above_hispeed_delay);
-	above_hispeed_delay = new_above_hispeed_delay;
-	nabove_hispeed_delay = ntokens;
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&ppol->above_hispeed_delay_lock, flags);
+	if (ppol->above_hispeed_delay != default_above_hispeed_delay)
+		kfree(ppol->above_hispeed_delay);
+	ppol->above_hispeed_delay = new_above_hispeed_delay;
+	ppol->nabove_hispeed_delay = ntokens;
+	spin_unlock_irqrestore(&ppol->above_hispeed_delay_lock, flags);
 	return count;
 
 }
 
-static struct global_attr above_hispeed_delay_attr =
-	__ATTR(above_hispeed_delay, S_IRUGO | S_IWUSR,
-		show_above_hispeed_delay, store_above_hispeed_delay);
-
-static ssize_t show_hispeed_freq(struct kobject *kobj,
-				 struct attribute *attr, char *buf)
+static ssize_t show_hispeed_freq(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%u\n", hispeed_freq);
+	return sprintf(buf, "%u\n", ppol->hispeed_freq);
 }
 
-static ssize_t store_hispeed_freq(struct kobject *kobj,
-				  struct attribute *attr, const char *buf,
-				  size_t count)
+static ssize_t store_hispeed_freq(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	long unsigned int val;
@@ -836,22 +888,19 @@ static ssize_t store_hispeed_freq(struct kobject *kobj,
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	hispeed_freq = val;
+	ppol->hispeed_freq = val;
 	return count;
 }
 
-static struct global_attr hispeed_freq_attr = __ATTR(hispeed_freq, 0644,
-		show_hispeed_freq, store_hispeed_freq);
-
-
-static ssize_t show_go_hispeed_load(struct kobject *kobj,
-				     struct attribute *attr, char *buf)
+static ssize_t show_go_hispeed_load(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%lu\n", go_hispeed_load);
+	return sprintf(buf, "%lu\n", ppol->go_hispeed_load);
 }
 
-static ssize_t store_go_hispeed_load(struct kobject *kobj,
-			struct attribute *attr, const char *buf, size_t count)
+static ssize_t store_go_hispeed_load(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	unsigned long val;
@@ -859,21 +908,19 @@ static ssize_t store_go_hispeed_load(struct kobject *kobj,
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	go_hispeed_load = val;
+	ppol->go_hispeed_load = val;
 	return count;
 }
 
-static struct global_attr go_hispeed_load_attr = __ATTR(go_hispeed_load, 0644,
-		show_go_hispeed_load, store_go_hispeed_load);
-
-static ssize_t show_min_sample_time(struct kobject *kobj,
-				struct attribute *attr, char *buf)
+static ssize_t show_min_sample_time(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%lu\n", min_sample_time);
+	return sprintf(buf, "%lu\n", ppol->min_sample_time);
 }
 
-static ssize_t store_min_sample_time(struct kobject *kobj,
-			struct attribute *attr, const char *buf, size_t count)
+static ssize_t store_min_sample_time(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	unsigned long val;
@@ -881,21 +928,19 @@ static ssize_t store_min_sample_time(struct kobject *kobj,
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	min_sample_time = val;
+	ppol->min_sample_time = val;
 	return count;
 }
 
-static struct global_attr min_sample_time_attr = __ATTR(min_sample_time, 0644,
-		show_min_sample_time, store_min_sample_time);
-
-static ssize_t show_timer_rate(struct kobject *kobj,
-			struct attribute *attr, char *buf)
+static ssize_t show_timer_rate(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%lu\n", timer_rate);
+	return sprintf(buf, "%lu\n", ppol->timer_rate);
 }
 
-static ssize_t store_timer_rate(struct kobject *kobj,
-			struct attribute *attr, const char *buf, size_t count)
+static ssize_t store_timer_rate(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	unsigned long val;
@@ -903,21 +948,18 @@ static ssize_t store_timer_rate(struct kobject *kobj,
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	timer_rate = val;
+	ppol->timer_rate = val;
 	return count;
 }
 
-static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
-		show_timer_rate, store_timer_rate);
-
 static ssize_t show_timer_slack(
-	struct kobject *kobj, struct attribute *attr, char *buf)
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%d\n", timer_slack_val);
+	return sprintf(buf, "%d\n", ppol->timer_slack_val);
 }
 
 static ssize_t store_timer_slack(
-	struct kobject *kobj, struct attribute *attr, const char *buf,
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
 	size_t count)
 {
 	int ret;
@@ -927,20 +969,19 @@ static ssize_t store_timer_slack(
 	if (ret < 0)
 		return ret;
 
-	timer_slack_val = val;
+	ppol->timer_slack_val = val;
 	return count;
 }
 
-define_one_global_rw(timer_slack);
-
-static ssize_t show_boost(struct kobject *kobj, struct attribute *attr,
-			  char *buf)
+static ssize_t show_boost(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%d\n", boost_val);
+	return sprintf(buf, "%d\n", ppol->boost_val);
 }
 
-static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
-			   const char *buf, size_t count)
+static ssize_t store_boost(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	unsigned long val;
@@ -949,11 +990,11 @@ static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
 	if (ret < 0)
 		return ret;
 
-	boost_val = val;
+	ppol->boost_val = val;
 
-	if (boost_val) {
+	if (ppol->boost_val) {
 		trace_cpufreq_interactive_boost("on");
-		cpufreq_interactive_boost();
+		cpufreq_interactive_boost(ppol);
 	} else {
 		trace_cpufreq_interactive_unboost("off");
 	}
@@ -961,10 +1002,9 @@ static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
 	return count;
 }
 
-define_one_global_rw(boost);
-
-static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
-				const char *buf, size_t count)
+static ssize_t store_boostpulse(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	unsigned long val;
@@ -973,23 +1013,21 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 	if (ret < 0)
 		return ret;
 
-	boostpulse_endtime = ktime_to_us(ktime_get()) + boostpulse_duration_val;
+	ppol->boostpulse_endtime = ktime_to_us(ktime_get()) +
+		ppol->boostpulse_duration_val;
 	trace_cpufreq_interactive_boost("pulse");
-	cpufreq_interactive_boost();
+	cpufreq_interactive_boost(ppol);
 	return count;
 }
 
-static struct global_attr boostpulse =
-	__ATTR(boostpulse, 0200, NULL, store_boostpulse);
-
 static ssize_t show_boostpulse_duration(
-	struct kobject *kobj, struct attribute *attr, char *buf)
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%d\n", boostpulse_duration_val);
+	return sprintf(buf, "%d\n", ppol->boostpulse_duration_val);
 }
 
 static ssize_t store_boostpulse_duration(
-	struct kobject *kobj, struct attribute *attr, const char *buf,
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
 	size_t count)
 {
 	int ret;
@@ -999,20 +1037,39 @@ static ssize_t store_boostpulse_duration(
 	if (ret < 0)
 		return ret;
 
-	boostpulse_duration_val = val;
+	ppol->boostpulse_duration_val = val;
 	return count;
 }
 
-define_one_global_rw(boostpulse_duration);
+static ssize_t show_io_is_busy(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
+{
+	return sprintf(buf, "%u\n", ppol->io_is_busy);
+}
+
+static ssize_t store_io_is_busy(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	ppol->io_is_busy = val;
+	return count;
+}
 
-static ssize_t show_io_is_busy(struct kobject *kobj,
-			struct attribute *attr, char *buf)
+static ssize_t show_use_sched_load(
+	struct cpufreq_interactive_policyinfo *ppol, char *buf)
 {
-	return sprintf(buf, "%u\n", io_is_busy);
+	return sprintf(buf, "%u\n", ppol->use_sched_load);
 }
 
-static ssize_t store_io_is_busy(struct kobject *kobj,
-			struct attribute *attr, const char *buf, size_t count)
+static ssize_t store_use_sched_load(
+	struct cpufreq_interactive_policyinfo *ppol, const char *buf,
+	size_t count)
 {
 	int ret;
 	unsigned long val;
@@ -1020,30 +1077,203 @@ static ssize_t store_io_is_busy(struct kobject *kobj,
 	ret = kstrtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	io_is_busy = val;
+	ppol->use_sched_load = val;
 	return count;
 }
 
-static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
-		show_io_is_busy, store_io_is_busy);
+/*
+ * Applies a write to the global tunables and to every instance. Called
+ * from the global attributes, which are removed with gov_lock held, so
+ * gov_lock must not be taken here.
+ */
+static ssize_t store_all_policyinfo(
+	ssize_t (*store)(struct cpufreq_interactive_policyinfo *ppol,
+			 const char *buf, size_t count),
+	const char *buf, size_t count)
+{
+	struct cpufreq_interactive_policyinfo *ppol;
+	ssize_t ret;
+
+	mutex_lock(&policyinfo_list_lock);
+	ret = store(&global_tunables, buf, count);
+	if (ret >= 0) {
+		list_for_each_entry(ppol, &policyinfo_list, list) {
+			ret = store(ppol, buf, count);
+			if (ret < 0)
+				break;
+		}
+	}
+	mutex_unlock(&policyinfo_list_lock);
+
+	return ret;
+}
+
+/* Attributes of the per-policy "interactive" directories */
+#define show_store_gov_pol(name)					\
+static ssize_t show_##name##_gov_pol(struct kobject *kobj,		\
+		struct attribute *attr, char *buf)			\
+{									\
+	return show_##name(to_policyinfo(kobj), buf);			\
+}									\
+static ssize_t store_##name##_gov_pol(struct kobject *kobj,		\
+		struct attribute *attr, const char *buf, size_t count)	\
+{									\
+	return store_##name(to_policyinfo(kobj), buf, count);		\
+}
+
+/* Attributes of the global "interactive" directory */
+#define show_store_gov_sys(name)					\
+static ssize_t show_##name##_gov_sys(struct kobject *kobj,		\
+		struct attribute *attr, char *buf)			\
+{									\
+	return show_##name(&global_tunables, buf);			\
+}									\
+static ssize_t store_##name##_gov_sys(struct kobject *kobj,		\
+		struct attribute *attr, const char *buf, size_t count)	\
+{									\
+	return store_all_policyinfo(store_##name, buf, count);		\
+}
+
+#define gov_pol_sys_attr_rw(name)					\
+show_store_gov_pol(name)						\
+show_store_gov_sys(name)						\
+static struct global_attr name##_gov_pol =				\
+	__ATTR(name, 0644, show_##name##_gov_pol, store_##name##_gov_pol); \
+static struct global_attr name##_gov_sys =				\
+	__ATTR(name, 0644, show_##name##_gov_sys, store_##name##_gov_sys)
+
+gov_pol_sys_attr_rw(target_loads);
+gov_pol_sys_attr_rw(above_hispeed_delay);
+gov_pol_sys_attr_rw(hispeed_freq);
+gov_pol_sys_attr_rw(go_hispeed_load);
+gov_pol_sys_attr_rw(min_sample_time);
+gov_pol_sys_attr_rw(timer_rate);
+gov_pol_sys_attr_rw(timer_slack);
+gov_pol_sys_attr_rw(boostpulse_duration);
+gov_pol_sys_attr_rw(io_is_busy);
+gov_pol_sys_attr_rw(use_sched_load);
+
+show_store_gov_pol(boost);
+static struct global_attr boost_gov_pol =
+	__ATTR(boost, 0644, show_boost_gov_pol, store_boost_gov_pol);
+
+static ssize_t store_boostpulse_gov_pol(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	return store_boostpulse(to_policyinfo(kobj), buf, count);
+}
+
+static struct global_attr boostpulse_gov_pol =
+	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_pol);
 
 static struct attribute *interactive_attributes[] = {
-	&target_loads_attr.attr,
-	&above_hispeed_delay_attr.attr,
-	&hispeed_freq_attr.attr,
-	&go_hispeed_load_attr.attr,
-	&min_sample_time_attr.attr,
-	&timer_rate_attr.attr,
-	&timer_slack.attr,
-	&boost.attr,
-	&boostpulse.attr,
-	&boostpulse_duration.attr,
-	&io_is_busy_attr.attr,
+	&target_loads_gov_pol.attr,
+	&above_hispeed_delay_gov_pol.attr,
+	&hispeed_freq_gov_pol.attr,
+	&go_hispeed_load_gov_pol.attr,
+	&min_sample_time_gov_pol.attr,
+	&timer_rate_gov_pol.attr,
+	&timer_slack_gov_pol.attr,
+	&boost_gov_pol.attr,
+	&boostpulse_gov_pol.attr,
+	&boostpulse_duration_gov_pol.attr,
+	&io_is_busy_gov_pol.attr,
+	&use_sched_load_gov_pol.attr,
 	NULL,
 };
 
 static struct attribute_group interactive_attr_group = {
 	.attrs = interactive_attributes,
+};
+
+/*
+ * The global boost and boostpulse are traced once, rather than once per
+ * governor instance.
+ */
+static ssize_t show_global_boost(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", global_tunables.boost_val);
+}
+
+static ssize_t store_global_boost(struct kobject *kobj,
+				  struct attribute *attr, const char *buf,
+				  size_t count)
+{
+	struct cpufreq_interactive_policyinfo *ppol;
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val)
+		trace_cpufreq_interactive_boost("on");
+	else
+		trace_cpufreq_interactive_unboost("off");
+
+	mutex_lock(&policyinfo_list_lock);
+	global_tunables.boost_val = val;
+	list_for_each_entry(ppol, &policyinfo_list, list) {
+		ppol->boost_val = val;
+		if (val)
+			cpufreq_interactive_boost(ppol);
+	}
+	mutex_unlock(&policyinfo_list_lock);
+
+	return count;
+}
+
+static struct global_attr global_boost_attr = __ATTR(boost, 0644,
+		show_global_boost, store_global_boost);
+
+static ssize_t store_global_boostpulse(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct cpufreq_interactive_policyinfo *ppol;
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	trace_cpufreq_interactive_boost("pulse");
+
+	mutex_lock(&policyinfo_list_lock);
+	list_for_each_entry(ppol, &policyinfo_list, list) {
+		ppol->boostpulse_endtime = ktime_to_us(ktime_get()) +
+			ppol->boostpulse_duration_val;
+		cpufreq_interactive_boost(ppol);
+	}
+	mutex_unlock(&policyinfo_list_lock);
+
+	return count;
+}
+
+static struct global_attr global_boostpulse_attr =
+	__ATTR(boostpulse, 0200, NULL, store_global_boostpulse);
+
+static struct attribute *interactive_global_attributes[] = {
+	&target_loads_gov_sys.attr,
+	&above_hispeed_delay_gov_sys.attr,
+	&hispeed_freq_gov_sys.attr,
+	&go_hispeed_load_gov_sys.attr,
+	&min_sample_time_gov_sys.attr,
+	&timer_rate_gov_sys.attr,
+	&timer_slack_gov_sys.attr,
+	&global_boost_attr.attr,
+	&global_boostpulse_attr.attr,
+	&boostpulse_duration_gov_sys.attr,
+	&io_is_busy_gov_sys.attr,
+	&use_sched_load_gov_sys.attr,
+	NULL,
+};
+
+static struct attribute_group interactive_global_attr_group = {
+	.attrs = interactive_global_attributes,
 	.name = "interactive",
 };
 
@@ -1067,12 +1297,144 @@ static struct notifier_block cpufreq_interactive_idle_nb = {
 	.notifier_call = cpufreq_interactive_idle_notifier,
 };
 
+/* Sets the default tunables, for global_tunables */
+static void init_tunables(struct cpufreq_interactive_policyinfo *ppol)
+{
+	ppol->go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
+	ppol->target_loads = default_target_loads;
+	ppol->ntarget_loads = ARRAY_SIZE(default_target_loads);
+	ppol->min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+	ppol->timer_rate = DEFAULT_TIMER_RATE;
+	ppol->above_hispeed_delay = default_above_hispeed_delay;
+	ppol->nabove_hispeed_delay =
+		ARRAY_SIZE(default_above_hispeed_delay);
+	ppol->boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
+	ppol->timer_slack_val = DEFAULT_TIMER_SLACK;
+	spin_lock_init(&ppol->target_loads_lock);
+	spin_lock_init(&ppol->above_hispeed_delay_lock);
+}
+
+/*
+ * Copies the tunables of 'src' to the new instance 'dst'. Called with
+ * policyinfo_list_lock held, which keeps global_tunables stable.
+ */
+static int copy_tunables(struct cpufreq_interactive_policyinfo *dst,
+			 struct cpufreq_interactive_policyinfo *src)
+{
+	unsigned int *data;
+
+	dst->hispeed_freq = src->hispeed_freq;
+	dst->go_hispeed_load = src->go_hispeed_load;
+	dst->min_sample_time = src->min_sample_time;
+	dst->timer_rate = src->timer_rate;
+	dst->boost_val = src->boost_val;
+	dst->boostpulse_duration_val = src->boostpulse_duration_val;
+	dst->timer_slack_val = src->timer_slack_val;
+	dst->io_is_busy = src->io_is_busy;
+	dst->use_sched_load = src->use_sched_load;
+
+	dst->target_loads = default_target_loads;
+	dst->ntarget_loads = ARRAY_SIZE(default_target_loads);
+	if (src->target_loads != default_target_loads) {
+		data = kmemdup(src->target_loads,
+			       src->ntarget_loads * sizeof(*data), GFP_KERNEL);
+		if (!data)
+			return -ENOMEM;
+		dst->target_loads = data;
+		dst->ntarget_loads = src->ntarget_loads;
+	}
+
+	dst->above_hispeed_delay = default_above_hispeed_delay;
+	dst->nabove_hispeed_delay = ARRAY_SIZE(default_above_hispeed_delay);
+	if (src->above_hispeed_delay != default_above_hispeed_delay) {
+		data = kmemdup(src->above_hispeed_delay,
+			       src->nabove_hispeed_delay * sizeof(*data),
+			       GFP_KERNEL);
+		if (!data)
+			return -ENOMEM;
+		dst->above_hispeed_delay = data;
+		dst->nabove_hispeed_delay = src->nabove_hispeed_delay;
+	}
+
+	return 0;
+}
+
+static void free_policyinfo(struct cpufreq_interactive_policyinfo *ppol);
+
+/*
+ * Returns the governor instance of a policy, allocating it the first time
+ * the governor is started on it. Called with gov_lock held.
+ */
+static struct cpufreq_interactive_policyinfo *get_policyinfo(
+	struct cpufreq_policy *policy)
+{
+	struct cpufreq_interactive_policyinfo *ppol;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+	unsigned int j;
+	int err;
+
+	for_each_cpu(j, policy->cpus) {
+		ppol = per_cpu(cpuinfo, j).ppol;
+		if (ppol)
+			return ppol;
+	}
+
+	ppol = kzalloc(sizeof(*ppol), GFP_KERNEL);
+	if (!ppol)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&ppol->target_loads_lock);
+	spin_lock_init(&ppol->speedchange_cpumask_lock);
+	spin_lock_init(&ppol->above_hispeed_delay_lock);
+
+	ppol->speedchange_task =
+		kthread_create(cpufreq_interactive_speedchange_task, ppol,
+			       "cfinteractive/%d", policy->cpu);
+	if (IS_ERR(ppol->speedchange_task)) {
+		err = PTR_ERR(ppol->speedchange_task);
+		kfree(ppol);
+		return ERR_PTR(err);
+	}
+
+	sched_setscheduler_nocheck(ppol->speedchange_task, SCHED_FIFO, &param);
+	get_task_struct(ppol->speedchange_task);
+
+	/* NB: wake up so the thread does not look hung to the freezer */
+	wake_up_process(ppol->speedchange_task);
+
+	/* Start from the global tunables, without missing a write to them */
+	mutex_lock(&policyinfo_list_lock);
+	err = copy_tunables(ppol, &global_tunables);
+	if (!err)
+		list_add_tail(&ppol->list, &policyinfo_list);
+	mutex_unlock(&policyinfo_list_lock);
+
+	if (err) {
+		free_policyinfo(ppol);
+		return ERR_PTR(err);
+	}
+
+	return ppol;
+}
+
+static void free_policyinfo(struct cpufreq_interactive_policyinfo *ppol)
+{
+	kthread_stop(ppol->speedchange_task);
+	put_task_struct(ppol->speedchange_task);
+	if (ppol->target_loads != default_target_loads)
+		kfree(ppol->target_loads);
+	if (ppol->above_hispeed_delay != default_above_hispeed_delay)
+		kfree(ppol->above_hispeed_delay);
+	kfree(ppol);
+}
+
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event)
 {
 	int rc;
 	unsigned int j;
 	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_interactive_policyinfo *ppol;
 	struct cpufreq_frequency_table *freq_table;
 
 	switch (event) {
@@ -1082,10 +1444,42 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 
 		mutex_lock(&gov_lock);
 
+		ppol = get_policyinfo(policy);
+		if (IS_ERR(ppol)) {
+			mutex_unlock(&gov_lock);
+			return PTR_ERR(ppol);
+		}
+
 		freq_table =
 			cpufreq_frequency_get_table(policy->cpu);
-		if (!hispeed_freq)
-			hispeed_freq = policy->max;
+		if (!ppol->hispeed_freq)
+			ppol->hispeed_freq = policy->max;
+
+		/* to_policyinfo() finds the instance through these */
+		for_each_cpu(j, policy->cpus)
+			per_cpu(cpuinfo, j).ppol = ppol;
+
+		/*
+		 * Create the tunables before starting the timers: if this
+		 * fails, the core never sends GOV_STOP.
+		 */
+		if (per_policy) {
+			ppol->kobj = kobject_create_and_add("interactive",
+							    &policy->kobj);
+			if (!ppol->kobj) {
+				mutex_unlock(&gov_lock);
+				return -ENOMEM;
+			}
+
+			rc = sysfs_create_group(ppol->kobj,
+						&interactive_attr_group);
+			if (rc) {
+				kobject_put(ppol->kobj);
+				ppol->kobj = NULL;
+				mutex_unlock(&gov_lock);
+				return rc;
+			}
+		}
 
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
@@ -1113,7 +1507,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		}
 
 		rc = sysfs_create_group(cpufreq_global_kobject,
-				&interactive_attr_group);
+				&interactive_global_attr_group);
 		if (rc) {
 			mutex_unlock(&gov_lock);
 			return rc;
@@ -1136,6 +1530,13 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			up_write(&pcpu->enable_sem);
 		}
 
+		/* The instance itself is kept for the next start */
+		ppol = per_cpu(cpuinfo, policy->cpu).ppol;
+		if (ppol && ppol->kobj) {
+			kobject_put(ppol->kobj);
+			ppol->kobj = NULL;
+		}
+
 		if (--active_count > 0) {
 			mutex_unlock(&gov_lock);
 			return 0;
@@ -1145,7 +1546,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
 		sysfs_remove_group(cpufreq_global_kobject,
-				&interactive_attr_group);
+				&interactive_global_attr_group);
 		mutex_unlock(&gov_lock);
 
 		break;
@@ -1197,7 +1598,6 @@ static int __init cpufreq_interactive_init(void)
 {
 	unsigned int i;
 	struct cpufreq_interactive_cpuinfo *pcpu;
-	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
@@ -1211,21 +1611,8 @@ static int __init cpufreq_interactive_init(void)
 		init_rwsem(&pcpu->enable_sem);
 	}
 
-	spin_lock_init(&target_loads_lock);
-	spin_lock_init(&speedchange_cpumask_lock);
-	spin_lock_init(&above_hispeed_delay_lock);
 	mutex_init(&gov_lock);
-	speedchange_task =
-		kthread_create(cpufreq_interactive_speedchange_task, NULL,
-			       "cfinteractive");
-	if (IS_ERR(speedchange_task))
-		return PTR_ERR(speedchange_task);
-
-	sched_setscheduler_nocheck(speedchange_task, SCHED_FIFO, &param);
-	get_task_struct(speedchange_task);
-
-	/* NB: wake up so the thread does not look hung to the freezer */
-	wake_up_process(speedchange_task);
+	init_tunables(&global_tunables);
 
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 }
@@ -1238,9 +1625,21 @@ module_init(cpufreq_interactive_init);
 
 static void __exit cpufreq_interactive_exit(void)
 {
+	struct cpufreq_interactive_policyinfo *ppol, *tmp;
+
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
-	kthread_stop(speedchange_task);
-	put_task_struct(speedchange_task);
+
+	/* No instance is in use once the governor is unregistered */
+	list_for_each_entry_safe(ppol, tmp, &policyinfo_list, list) {
+		list_del(&ppol->list);
+		free_policyinfo(ppol);
+	}
+
+	if (global_tunables.target_loads != default_target_loads)
+		kfree(global_tunables.target_loads);
+	if (global_tunables.above_hispeed_delay !=
+	    default_above_hispeed_delay)
+		kfree(global_tunables.above_hispeed_delay);
 }
 
 module_exit(cpufreq_interactive_exit);
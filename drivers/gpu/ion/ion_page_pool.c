@@ -0,0 +1,316 @@
+/*
+ * drivers/gpu/ion/ion_page_pool.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/err.h>
+#include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include "ion_priv.h"
+
+/*
+ * All pools, for the shrinker and the zeroing thread. Pages freed to a pool
+ * are put on its dirty list and zeroed by ion_page_pool_zero_thread before
+ * they are handed out again. The thread takes them off their pools in
+ * batches and zeroes them without ion_page_pools_lock, so that it doesn't
+ * lock out the shrinker; ion_page_pool_zero_lock keeps a pool from being
+ * destroyed while some of its pages are being zeroed.
+ */
+#define ION_PAGE_POOL_ZERO_BATCH	32
+
+static LIST_HEAD(ion_page_pools);
+static DEFINE_MUTEX(ion_page_pools_lock);
+static DEFINE_MUTEX(ion_page_pool_zero_lock);
+static struct task_struct *ion_page_pool_zero_task;
+static DECLARE_WAIT_QUEUE_HEAD(ion_page_pool_zero_wait);
+static atomic_t ion_page_pool_dirty = ATOMIC_INIT(0);
+
+static void ion_page_pool_zero(struct ion_page_pool *pool, struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		clear_highpage(page + i);
+}
+
+static struct page *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	page = alloc_pages(pool->gfp_mask | __GFP_ZERO, pool->order);
+	if (!page)
+		return NULL;
+
+	/*
+	 * Buffers are mapped page by page, so give every page of the chunk
+	 * its own reference count.
+	 */
+	if (pool->order)
+		split_page(page, pool->order);
+	return page;
+}
+
+static void ion_page_pool_free_pages(struct ion_page_pool *pool,
+				     struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		__free_page(page + i);
+}
+
+/* Takes a page off 'list' of 'pool', or returns NULL if it is empty */
+static struct page *ion_page_pool_remove(struct ion_page_pool *pool,
+					 struct list_head *list, int *count)
+{
+	struct page *page;
+
+	if (list_empty(list))
+		return NULL;
+
+	page = list_first_entry(list, struct page, lru);
+	list_del(&page->lru);
+	(*count)--;
+	return page;
+}
+
+/**
+ * ion_page_pool_alloc - allocate a zeroed chunk of 2^order pages
+ * @pool:	the pool to allocate from
+ *
+ * Zeroed pages of the pool are used first, then dirty ones, and only
+ * then the page allocator is asked for more.
+ */
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page;
+	bool dirty = false;
+
+	mutex_lock(&pool->mutex);
+	page = ion_page_pool_remove(pool, &pool->items, &pool->count);
+	if (!page) {
+		page = ion_page_pool_remove(pool, &pool->dirty_items,
+					    &pool->dirty_count);
+		dirty = page != NULL;
+	}
+	mutex_unlock(&pool->mutex);
+
+	if (!page)
+		return ion_page_pool_alloc_pages(pool);
+
+	if (dirty) {
+		atomic_dec(&ion_page_pool_dirty);
+		ion_page_pool_zero(pool, page);
+	}
+	return page;
+}
+
+/**
+ * ion_page_pool_free - give a chunk of 2^order pages back to the pool
+ * @pool:	the pool the chunk was allocated from
+ * @page:	first page of the chunk
+ *
+ * The chunk is zeroed in the background before it is used again.
+ */
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	list_add_tail(&page->lru, &pool->dirty_items);
+	pool->dirty_count++;
+	mutex_unlock(&pool->mutex);
+
+	atomic_inc(&ion_page_pool_dirty);
+	wake_up_interruptible(&ion_page_pool_zero_wait);
+}
+
+/* Moves a batch of dirty chunks of 'pool' to 'list', tagged with 'pool' */
+static void ion_page_pool_take_dirty(struct ion_page_pool *pool,
+				     struct list_head *list)
+{
+	struct page *page;
+	int i;
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < ION_PAGE_POOL_ZERO_BATCH; i++) {
+		page = ion_page_pool_remove(pool, &pool->dirty_items,
+					    &pool->dirty_count);
+		if (!page)
+			break;
+
+		atomic_dec(&ion_page_pool_dirty);
+		set_page_private(page, (unsigned long)pool);
+		list_add_tail(&page->lru, list);
+	}
+	mutex_unlock(&pool->mutex);
+}
+
+/* Zeroes the chunks on 'list' and gives them back to their pools */
+static void ion_page_pool_zero_list(struct list_head *list)
+{
+	struct ion_page_pool *pool;
+	struct page *page, *tmp;
+
+	list_for_each_entry_safe(page, tmp, list, lru) {
+		pool = (struct ion_page_pool *)page_private(page);
+		set_page_private(page, 0);
+		ion_page_pool_zero(pool, page);
+
+		mutex_lock(&pool->mutex);
+		list_move_tail(&page->lru, &pool->items);
+		pool->count++;
+		mutex_unlock(&pool->mutex);
+
+		cond_resched();
+	}
+}
+
+static int ion_page_pool_zero_thread(void *data)
+{
+	struct ion_page_pool *pool;
+	LIST_HEAD(dirty);
+
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(ion_page_pool_zero_wait,
+				atomic_read(&ion_page_pool_dirty) ||
+				kthread_should_stop());
+
+		mutex_lock(&ion_page_pool_zero_lock);
+		mutex_lock(&ion_page_pools_lock);
+		list_for_each_entry(pool, &ion_page_pools, list)
+			ion_page_pool_take_dirty(pool, &dirty);
+		mutex_unlock(&ion_page_pools_lock);
+
+		ion_page_pool_zero_list(&dirty);
+		mutex_unlock(&ion_page_pool_zero_lock);
+	}
+
+	return 0;
+}
+
+/* Frees up to 'nr_to_scan' pages of 'pool', dirty ones first */
+static int ion_page_pool_shrink_one(struct ion_page_pool *pool,
+				    int nr_to_scan)
+{
+	struct page *page;
+	int freed = 0;
+
+	while (freed < nr_to_scan) {
+		mutex_lock(&pool->mutex);
+		page = ion_page_pool_remove(pool, &pool->dirty_items,
+					    &pool->dirty_count);
+		if (page)
+			atomic_dec(&ion_page_pool_dirty);
+		else
+			page = ion_page_pool_remove(pool, &pool->items,
+						    &pool->count);
+		mutex_unlock(&pool->mutex);
+		if (!page)
+			break;
+
+		ion_page_pool_free_pages(pool, page);
+		freed += 1 << pool->order;
+	}
+
+	return freed;
+}
+
+static int ion_page_pool_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	struct ion_page_pool *pool;
+	int nr_to_scan = sc->nr_to_scan;
+	int nr_total = 0;
+
+	/* pools are created with ion_page_pools_lock held */
+	if (!mutex_trylock(&ion_page_pools_lock))
+		return nr_to_scan ? -1 : 0;
+
+	list_for_each_entry(pool, &ion_page_pools, list) {
+		if (nr_to_scan > 0)
+			nr_to_scan -= ion_page_pool_shrink_one(pool,
+							       nr_to_scan);
+		nr_total += (pool->count + pool->dirty_count) << pool->order;
+	}
+	mutex_unlock(&ion_page_pools_lock);
+
+	return nr_total;
+}
+
+static struct shrinker ion_page_pool_shrinker = {
+	.shrink = ion_page_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/**
+ * ion_page_pool_create - create a pool of chunks of 2^order pages
+ * @gfp_mask:	flags used to allocate chunks from the page allocator
+ * @order:	order of the chunks
+ *
+ * returns a valid pool or -PTR_ERR
+ */
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
+{
+	struct ion_page_pool *pool;
+	struct task_struct *task;
+
+	pool = kzalloc(sizeof(struct ion_page_pool), GFP_KERNEL);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	INIT_LIST_HEAD(&pool->items);
+	INIT_LIST_HEAD(&pool->dirty_items);
+	mutex_init(&pool->mutex);
+	pool->gfp_mask = gfp_mask;
+	pool->order = order;
+
+	mutex_lock(&ion_page_pools_lock);
+	if (!ion_page_pool_zero_task) {
+		task = kthread_run(ion_page_pool_zero_thread, NULL,
+				   "ion_page_pool");
+		if (IS_ERR(task)) {
+			mutex_unlock(&ion_page_pools_lock);
+			kfree(pool);
+			return ERR_CAST(task);
+		}
+		ion_page_pool_zero_task = task;
+		register_shrinker(&ion_page_pool_shrinker);
+	}
+	list_add_tail(&pool->list, &ion_page_pools);
+	mutex_unlock(&ion_page_pools_lock);
+
+	return pool;
+}
+
+void ion_page_pool_destroy(struct ion_page_pool *pool)
+{
+	mutex_lock(&ion_page_pools_lock);
+	list_del(&pool->list);
+	mutex_unlock(&ion_page_pools_lock);
+
+	/* wait for the zeroing thread to give back chunks it took */
+	mutex_lock(&ion_page_pool_zero_lock);
+	mutex_unlock(&ion_page_pool_zero_lock);
+
+	ion_page_pool_shrink_one(pool, INT_MAX);
+	kfree(pool);
+}
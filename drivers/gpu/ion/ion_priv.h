@@ -261,6 +261,40 @@ struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *);
 void ion_cma_heap_destroy(struct ion_heap *);
 #endif
 
+/**
+ * struct ion_page_pool - pagepool struct
+ * @count:		number of zeroed chunks in the pool
+ * @dirty_count:	number of chunks waiting to be zeroed
+ * @items:		list of zeroed chunks
+ * @dirty_items:	list of chunks waiting to be zeroed
+ * @mutex:		lock protecting this struct
+ * @gfp_mask:		gfp_mask to use when allocating from the page
+ *			allocator
+ * @order:		order of the chunks in the pool
+ * @list:		entry in the list of all pools
+ *
+ * Allows chunks of 2^order pages to be cached between buffer allocations
+ * instead of going back to the page allocator every time. Freed chunks are
+ * zeroed by a background thread, and the pools are emptied by a shrinker
+ * when memory runs low. The pages of a chunk are split, so that each of
+ * them can be mapped on its own.
+ */
+struct ion_page_pool {
+	int count;
+	int dirty_count;
+	struct list_head items;
+	struct list_head dirty_items;
+	struct mutex mutex;
+	gfp_t gfp_mask;
+	unsigned int order;
+	struct list_head list;
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+
 struct ion_heap *msm_get_contiguous_heap(void);
 /**
  * The carveout/cp heap returns physical addresses, since 0 may be a valid
@@ -0,0 +1,179 @@
+/*
+ * drivers/staging/android/logger-bench.c
+ *
+ * Write throughput benchmark for the logger
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Starts 1 to 'max_threads' kernel threads that each write 'nr_writes'
+ * entries of 'msg_size' bytes to the log at 'path', and prints the write
+ * throughput for every number of threads when loaded, e.g:
+ *
+ *	modprobe logger-bench path=/dev/log/main max_threads=8
+ *	dmesg | grep logger-bench
+ *
+ * Loading always fails so that the benchmark can simply be run again.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#include "logger.h"
+
+static char *path = "/dev/log/main";
+static unsigned int max_threads = 8;
+static unsigned int nr_writes = 10000;
+static unsigned int msg_size = 64;
+
+struct logger_bench {
+	struct file *filp;
+	char *msg;
+	atomic_t running;
+	atomic_t errors;
+	struct completion done;
+};
+
+static int logger_bench_thread(void *data)
+{
+	struct logger_bench *bench = data;
+	mm_segment_t old_fs = get_fs();
+	unsigned int i;
+	loff_t pos = 0;
+
+	set_fs(KERNEL_DS);
+	for (i = 0; i < nr_writes; i++) {
+		if (vfs_write(bench->filp, (const char __user *)bench->msg,
+			      msg_size, &pos) != msg_size)
+			atomic_inc(&bench->errors);
+	}
+	set_fs(old_fs);
+
+	if (atomic_dec_and_test(&bench->running))
+		complete(&bench->done);
+
+	return 0;
+}
+
+static int logger_bench_run(struct logger_bench *bench, unsigned int threads)
+{
+	struct task_struct *task;
+	unsigned int i;
+	u64 ns, writes, bytes;
+	ktime_t start;
+
+	atomic_set(&bench->running, threads);
+	atomic_set(&bench->errors, 0);
+	init_completion(&bench->done);
+
+	start = ktime_get();
+	for (i = 0; i < threads; i++) {
+		task = kthread_run(logger_bench_thread, bench,
+				   "logger-bench/%u", i);
+		if (IS_ERR(task)) {
+			/* let the threads already started finish */
+			if (atomic_sub_and_test(threads - i, &bench->running))
+				complete(&bench->done);
+			wait_for_completion(&bench->done);
+			return PTR_ERR(task);
+		}
+	}
+	wait_for_completion(&bench->done);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_read(&bench->errors)) {
+		printk(KERN_ERR "logger-bench: %d writes failed\n",
+		       atomic_read(&bench->errors));
+		return -EIO;
+	}
+
+	/* entries and KB per second */
+	writes = (u64)threads * nr_writes * NSEC_PER_SEC;
+	bytes = writes * (sizeof(struct logger_entry) + msg_size);
+	writes = div64_u64(writes, ns);
+	bytes = div64_u64(bytes, ns * 1024);
+
+	printk(KERN_INFO "logger-bench: %2u %12llu %10llu\n",
+	       threads, writes, bytes);
+	return 0;
+}
+
+static int __init logger_bench_init(void)
+{
+	struct logger_bench bench;
+	unsigned int threads;
+	int ret = 0;
+
+	if (!max_threads || !nr_writes || !msg_size ||
+	    msg_size > LOGGER_ENTRY_MAX_PAYLOAD)
+		return -EINVAL;
+
+	bench.msg = kmalloc(msg_size, GFP_KERNEL);
+	if (!bench.msg)
+		return -ENOMEM;
+	/* priority, tag and message, as written by liblog */
+	memset(bench.msg, 'x', msg_size);
+	bench.msg[0] = 4;
+	bench.msg[msg_size - 1] = '\0';
+	if (msg_size > 14)
+		memcpy(bench.msg + 1, "logger-bench", 13);
+
+	bench.filp = filp_open(path, O_WRONLY, 0);
+	if (IS_ERR(bench.filp)) {
+		ret = PTR_ERR(bench.filp);
+		printk(KERN_ERR "logger-bench: can't open %s: %d\n",
+		       path, ret);
+		goto out;
+	}
+
+	printk(KERN_INFO "logger-bench: %u writes of %u bytes per thread\n",
+	       nr_writes, msg_size);
+	printk(KERN_INFO "logger-bench: threads  writes/sec     KB/sec\n");
+
+	for (threads = 1; threads <= max_threads; threads++) {
+		ret = logger_bench_run(&bench, threads);
+		if (ret)
+			break;
+	}
+
+	filp_close(bench.filp, NULL);
+out:
+	kfree(bench.msg);
+
+	/* Don't stay loaded: the benchmark runs once per load */
+	return ret ? ret : -EAGAIN;
+}
+
+static void __exit logger_bench_exit(void) { }
+
+module_init(logger_bench_init);
+module_exit(logger_bench_exit);
+
+module_param(path, charp, 0);
+MODULE_PARM_DESC(path, "Log device to write to");
+module_param(max_threads, uint, 0);
+MODULE_PARM_DESC(max_threads, "Maximum number of concurrent writers");
+module_param(nr_writes, uint, 0);
+MODULE_PARM_DESC(nr_writes, "Number of entries written by each thread");
+module_param(msg_size, uint, 0);
+MODULE_PARM_DESC(msg_size, "Payload size of each entry");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Android logger write benchmark");
@@ -24,6 +24,7 @@
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/time.h>
 #include "logger.h"
 
@@ -33,16 +34,25 @@
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting. The offsets and the list of readers
+ * are protected by the spinlock 'lock'.
+ *
+ * Writers don't serialize on the whole write: they reserve space for their
+ * entry and write its header under 'lock', copy the payload without it, and
+ * then commit. Entries between 'c_off' and 'w_off' are reserved but may not
+ * be complete yet, so readers only see entries before 'c_off'. Until it is
+ * committed, an entry has LOGGER_HDR_PENDING as its hdr_size; 'c_off' moves
+ * over the committed entries in write order as soon as they are.
  */
 struct logger_log {
 	unsigned char		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
-	wait_queue_head_t	wq;	/* wait queue for readers */
+	wait_queue_head_t	wq;	/* wait queue for readers and writers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
+	struct mutex		mutex;	/* mutex serializing readers */
+	spinlock_t		lock;	/* lock protecting offsets */
 	size_t			w_off;	/* current write head offset */
+	size_t			c_off;	/* end of the committed entries */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
 };
@@ -51,7 +61,8 @@ struct logger_log {
  * struct logger_reader - a logging device open for reading
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. 'r_off' is protected by log->lock, the rest by
+ * log->mutex.
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
@@ -59,14 +70,39 @@ struct logger_reader {
 	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
 	int			r_ver;	/* reader ABI version */
+	unsigned char		*buf;	/* entry being copied to user-space */
 };
 
+/*
+ * The maximum size of an entry. A writer that faults on its payload keeps
+ * the entry but marks it dead with a zero hdr_size; readers skip it.
+ */
+#define LOGGER_ENTRY_MAX_LEN \
+	(sizeof(struct logger_entry) + LOGGER_ENTRY_MAX_PAYLOAD)
+
+/* hdr_size of an entry that is reserved but not committed yet */
+#define LOGGER_HDR_PENDING	((__u16) ~0)
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 size_t logger_offset(struct logger_log *log, size_t n)
 {
 	return n & (log->size-1);
 }
 
+/*
+ * logger_readable - is there a committed entry at 'off'?
+ *
+ * Readers are never in the pending region, but fix_up_readers() can pull
+ * one forward into it; such a reader waits for the commit.
+ *
+ * Caller needs to hold log->lock.
+ */
+static inline bool logger_readable(struct logger_log *log, size_t off)
+{
+	return logger_offset(log, off - log->c_off) >
+		logger_offset(log, log->w_off - log->c_off);
+}
+
 
 /*
  * file_get_log - Given a file structure, return the associated log
@@ -120,7 +156,7 @@ static struct logger_entry *get_entry_header(struct logger_log *log,
  * In the log, the length does not include the size of the log entry structure.
  * This function returns the size including the log entry structure.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold log->lock.
  */
 static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
 {
@@ -164,72 +200,69 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log - copies the entry of 'count' bytes at the read head of 'reader'
+ * to its buffer and moves the read head to the next entry.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static void do_read_log(struct logger_log *log, struct logger_reader *reader,
+			size_t count)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
 	size_t len;
-	size_t msg_start;
 
-	/*
-	 * First, copy the header to userspace, using the version of
-	 * the header requested
-	 */
-	entry = get_entry_header(log, reader->r_off, &scratch);
-	if (copy_header_to_user(reader->r_ver, entry, buf))
-		return -EFAULT;
+	len = min(count, log->size - reader->r_off);
+	memcpy(reader->buf, log->buffer + reader->r_off, len);
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(log,
-		reader->r_off + sizeof(struct logger_entry));
+	if (count != len)
+		memcpy(reader->buf + len, log->buffer, count - len);
 
-	/*
-	 * We read from the msg in two disjoint operations. First, we read from
-	 * the current msg head offset up to 'count' bytes or to the end of
-	 * the log, whichever comes first.
-	 */
-	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
-		return -EFAULT;
+	reader->r_off = logger_offset(log, reader->r_off + count);
+}
 
-	/*
-	 * Second, we read any remaining bytes, starting back at the head of
-	 * the log.
-	 */
-	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
+/*
+ * copy_entry_to_user - copies the entry in the buffer of 'reader' into the
+ * user-space buffer 'buf', using the header version requested by the reader.
+ * Returns the number of bytes copied on success.
+ *
+ * Caller must hold log->mutex.
+ */
+static ssize_t copy_entry_to_user(struct logger_reader *reader,
+				  char __user *buf)
+{
+	struct logger_entry *entry = (struct logger_entry *) reader->buf;
+	size_t hdr_len = get_user_hdr_len(reader->r_ver);
+
+	if (copy_header_to_user(reader->r_ver, entry, buf))
+		return -EFAULT;
 
-	reader->r_off = logger_offset(log, reader->r_off +
-		sizeof(struct logger_entry) + count);
+	if (copy_to_user(buf + hdr_len, entry->msg, entry->len))
+		return -EFAULT;
 
-	return count + get_user_hdr_len(reader->r_ver);
+	return hdr_len + entry->len;
 }
 
 /*
- * get_next_entry_by_uid - Starting at 'off', returns an offset into
- * 'log->buffer' which contains the first entry readable by 'euid'
+ * get_next_readable_entry - Starting at the read head of 'reader', returns an
+ * offset into 'log->buffer' which contains the first committed entry readable
+ * by the reader, skipping dead entries and, unless the reader can read all of
+ * them, the entries of other users.
+ *
+ * Caller must hold log->lock.
  */
-static size_t get_next_entry_by_uid(struct logger_log *log,
-		size_t off, uid_t euid)
+static size_t get_next_readable_entry(struct logger_log *log,
+		struct logger_reader *reader)
 {
-	while (off != log->w_off) {
+	size_t off = reader->r_off;
+	uid_t euid = current_euid();
+
+	while (logger_readable(log, off)) {
 		struct logger_entry *entry;
 		struct logger_entry scratch;
 		size_t next_len;
 
 		entry = get_entry_header(log, off, &scratch);
 
-		if (entry->euid == euid)
+		if (entry->hdr_size && (reader->r_all || entry->euid == euid))
 			return off;
 
 		next_len = sizeof(struct logger_entry) + entry->len;
@@ -261,12 +294,11 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 
 start:
 	while (1) {
-		mutex_lock(&log->mutex);
-
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		spin_lock(&log->lock);
+		ret = !logger_readable(log, reader->r_off);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
@@ -288,27 +320,34 @@ start:
 		return ret;
 
 	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
+	reader->r_off = get_next_readable_entry(log, reader);
 
 	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
+	if (unlikely(!logger_readable(log, reader->r_off))) {
+		spin_unlock(&log->lock);
 		mutex_unlock(&log->mutex);
 		goto start;
 	}
 
 	/* get the size of the next entry */
-	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
-	if (count < ret) {
+	ret = get_entry_msg_len(log, reader->r_off);
+	if (count < get_user_hdr_len(reader->r_ver) + ret) {
+		spin_unlock(&log->lock);
 		ret = -EINVAL;
 		goto out;
 	}
 
-	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	/*
+	 * Get exactly one entry from the log. It is copied out of the ring
+	 * first since writers may overwrite it while it is being copied to
+	 * user-space.
+	 */
+	do_read_log(log, reader, sizeof(struct logger_entry) + ret);
+	spin_unlock(&log->lock);
+
+	ret = copy_entry_to_user(reader, buf);
 
 out:
 	mutex_unlock(&log->mutex);
@@ -320,7 +359,7 @@ out:
  * get_next_entry - return the offset of the first valid entry at least 'len'
  * bytes after 'off'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
 static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 {
@@ -371,7 +410,7 @@ static inline int is_between(size_t a, size_t b, size_t c)
  * We do this by "pulling forward" the readers and start head to the first
  * entry after the new write head.
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void fix_up_readers(struct logger_log *log, size_t len)
 {
@@ -388,56 +427,122 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 }
 
 /*
- * do_write_log - writes 'len' bytes from 'buf' to 'log'
- *
- * The caller needs to hold log->mutex.
+ * do_write_log - writes 'len' bytes from 'buf' to 'log' at offset 'off'
  */
-static void do_write_log(struct logger_log *log, const void *buf, size_t count)
+static void do_write_log(struct logger_log *log, size_t off,
+			 const void *buf, size_t count)
 {
 	size_t len;
 
-	len = min(count, log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, buf, len);
+	len = min(count, log->size - off);
+	memcpy(log->buffer + off, buf, len);
 
 	if (count != len)
 		memcpy(log->buffer, buf + len, count - len);
-
-	log->w_off = logger_offset(log, log->w_off + count);
-
 }
 
 /*
  * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
+ * the log 'log' at offset 'off'
  *
  * Returns 'count' on success, negative error code on failure.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
+static ssize_t do_write_log_from_user(struct logger_log *log, size_t off,
 				      const void __user *buf, size_t count)
 {
 	size_t len;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
+	len = min(count, log->size - off);
+	if (len && copy_from_user(log->buffer + off, buf, len))
 		return -EFAULT;
 
 	if (count != len)
 		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
 			return -EFAULT;
 
-	log->w_off = logger_offset(log, log->w_off + count);
-
 	return count;
 }
 
+/*
+ * logger_pending_len - bytes reserved by writers that did not commit yet
+ *
+ * The caller needs to hold log->lock.
+ */
+static inline size_t logger_pending_len(struct logger_log *log)
+{
+	return logger_offset(log, log->w_off - log->c_off);
+}
+
+/*
+ * logger_reserve - reserves space for the entry described by 'header' and
+ * writes the header. Returns the offset of the entry.
+ *
+ * Reservations are limited to half the log so that a writer never laps an
+ * entry that is still being copied.
+ */
+static size_t logger_reserve(struct logger_log *log,
+			     struct logger_entry *header)
+{
+	size_t len = sizeof(struct logger_entry) + header->len;
+	size_t off;
+
+	spin_lock(&log->lock);
+	while (unlikely(logger_pending_len(log) + len > log->size / 2)) {
+		spin_unlock(&log->lock);
+		wait_event(log->wq,
+			   logger_pending_len(log) + len <= log->size / 2);
+		spin_lock(&log->lock);
+	}
+
+	/*
+	 * Fix up any readers, pulling them forward to the first readable
+	 * entry after (what will be) the new write offset. We do this now
+	 * because if we partially fail, we can end up with clobbered log
+	 * entries that encroach on readable buffer.
+	 */
+	fix_up_readers(log, len);
+
+	off = log->w_off;
+	do_write_log(log, off, header, sizeof(struct logger_entry));
+	log->w_off = logger_offset(log, off + len);
+	spin_unlock(&log->lock);
+
+	return off;
+}
+
+/*
+ * logger_commit - sets the final 'hdr_size' of the entry at 'off' and makes
+ * it visible to readers, along with the committed entries after it, once
+ * all entries before it are committed too.
+ */
+static void logger_commit(struct logger_log *log, size_t off, __u16 hdr_size)
+{
+	struct logger_entry scratch;
+	struct logger_entry *entry;
+	size_t old;
+	bool moved;
+
+	spin_lock(&log->lock);
+	do_write_log(log, logger_offset(log, off +
+			offsetof(struct logger_entry, hdr_size)),
+		     &hdr_size, sizeof(hdr_size));
+
+	old = log->c_off;
+	while (log->c_off != log->w_off) {
+		entry = get_entry_header(log, log->c_off, &scratch);
+		if (entry->hdr_size == LOGGER_HDR_PENDING)
+			break;
+		log->c_off = logger_offset(log, log->c_off +
+				sizeof(struct logger_entry) + entry->len);
+	}
+	moved = log->c_off != old;
+	spin_unlock(&log->lock);
+
+	/* wake up any blocked readers, and writers waiting for space */
+	if (moved)
+		wake_up(&log->wq);
+}
+
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
@@ -447,9 +552,10 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
+	size_t off, msg_off;
+	__u16 hdr_size = sizeof(struct logger_entry);
 	ssize_t ret = 0;
 
 	now = current_kernel_time();
@@ -460,23 +566,14 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	header.nsec = now.tv_nsec;
 	header.euid = current_euid();
 	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
-	header.hdr_size = sizeof(struct logger_entry);
+	header.hdr_size = LOGGER_HDR_PENDING;
 
 	/* null writes succeed, return zero */
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	off = logger_reserve(log, &header);
+	msg_off = logger_offset(log, off + sizeof(struct logger_entry));
 
 	while (nr_segs-- > 0) {
 		size_t len;
@@ -486,21 +583,25 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
 		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
+		nr = do_write_log_from_user(log, msg_off, iov->iov_base, len);
 		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
+			/*
+			 * Later entries may already be reserved, so the
+			 * space can't be given back. Abandon the entry
+			 * instead, to avoid message corruption from
+			 * missing fragments.
+			 */
+			hdr_size = 0;
+			ret = nr;
+			break;
 		}
 
 		iov++;
 		ret += nr;
+		msg_off = logger_offset(log, msg_off + nr);
 	}
 
-	mutex_unlock(&log->mutex);
-
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	logger_commit(log, off, hdr_size);
 
 	return ret;
 }
@@ -532,6 +633,12 @@ static int logger_open(struct inode *inode, struct file *file)
 		if (!reader)
 			return -ENOMEM;
 
+		reader->buf = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->buf) {
+			kfree(reader);
+			return -ENOMEM;
+		}
+
 		reader->log = log;
 		reader->r_ver = 1;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
@@ -539,10 +646,10 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		INIT_LIST_HEAD(&reader->list);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -562,10 +669,11 @@ static int logger_release(struct inode *ignored, struct file *file)
 		struct logger_reader *reader = file->private_data;
 		struct logger_log *log = reader->log;
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		list_del(&reader->list);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
+		kfree(reader->buf);
 		kfree(reader);
 	}
 
@@ -595,14 +703,12 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
+	spin_lock(&log->lock);
+	reader->r_off = get_next_readable_entry(log, reader);
 
-	if (log->w_off != reader->r_off)
+	if (logger_readable(log, reader->r_off))
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -639,10 +745,12 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
+		spin_lock(&log->lock);
+		if (logger_readable(log, reader->r_off))
+			ret = logger_offset(log, log->c_off - reader->r_off);
 		else
-			ret = (log->size - reader->r_off) + log->w_off;
+			ret = 0;
+		spin_unlock(&log->lock);
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -651,24 +759,26 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
-		if (!reader->r_all)
-			reader->r_off = get_next_entry_by_uid(log,
-				reader->r_off, current_euid());
+		spin_lock(&log->lock);
+		reader->r_off = get_next_readable_entry(log, reader);
 
-		if (log->w_off != reader->r_off)
+		if (logger_readable(log, reader->r_off))
 			ret = get_user_hdr_len(reader->r_ver) +
 				get_entry_msg_len(log, reader->r_off);
 		else
 			ret = 0;
+		spin_unlock(&log->lock);
 		break;
 	case LOGGER_FLUSH_LOG:
 		if (!(file->f_mode & FMODE_WRITE)) {
 			ret = -EBADF;
 			break;
 		}
+		spin_lock(&log->lock);
 		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+			reader->r_off = log->c_off;
+		log->head = log->c_off;
+		spin_unlock(&log->lock);
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -723,7 +833,9 @@ static struct logger_log VAR = { \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
 	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.w_off = 0, \
+	.c_off = 0, \
 	.head = 0, \
 	.size = SIZE, \
 };
@@ -17,6 +17,13 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * By default processes are killed from the shrinker, i.e. by whoever is
+ * reclaiming memory. Writing 1 to event_mode moves the kills to a kernel
+ * thread instead. It is woken when the memory pressure reported by
+ * reclaim (see mm/vmpressure.c) reaches pressure_high percent, and keeps
+ * killing as allowed by minfree until the pressure falls below
+ * pressure_low or reclaim stops.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -34,8 +41,10 @@
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/oom.h>
+#include <linux/pid_namespace.h>
 #include <linux/sched.h>
 #include <linux/rcupdate.h>
+#include <linux/rculist_nulls.h>
 #include <linux/notifier.h>
 #include <linux/slab.h>
 #include <linux/ktime.h>
@@ -44,6 +53,9 @@
 #include <linux/writeback.h>
 #include <linux/swap.h>
 #include <linux/hardirq.h>
+#include <linux/kthread.h>
+#include <linux/vmpressure.h>
+#include <linux/wait.h>
 
 extern void drop_pagecache_sb(struct super_block *sb, void *unused);
 
@@ -70,6 +82,14 @@ static int lowmem_minfree_size = 6;
 static long shrink_batch = 10*256;
 static ktime_t lowmem_deathpending_timeout;
 
+static bool lowmem_event_mode;
+static uint lowmem_pressure_high = 95;
+static uint lowmem_pressure_low = 60;
+static bool lowmem_triggered;
+static unsigned int lowmem_events;
+static struct task_struct *lowmem_kthread;
+static DECLARE_WAIT_QUEUE_HEAD(lowmem_event_wait);
+
 #define LMK_BUSY (-1)
 #define LMK_LOG_TAG "lowmem_shrink "
 
@@ -79,11 +99,104 @@ static ktime_t lowmem_deathpending_timeout;
 			printk(LMK_LOG_TAG x);			\
 	} while (0)
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Processes are indexed by oom_score_adj so that a victim can be picked
+ * without walking the whole task list. Each bucket is terminated by a
+ * nulls value holding its own number: a reader that followed a process
+ * into another bucket while its oom_score_adj was being changed ends on
+ * the wrong nulls value and walks the bucket again.
+ *
+ * lowmem_index_lock nests inside tasklist_lock and siglock, which are
+ * taken with interrupts disabled, so it must be too.
+ */
+#define LOWMEM_INDEX_SIZE	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+#define LOWMEM_INDEX_RESTARTS	4
+
+static DEFINE_SPINLOCK(lowmem_index_lock);
+static struct hlist_nulls_head lowmem_index[LOWMEM_INDEX_SIZE];
+static bool lowmem_index_ready;
+
+static inline int lowmem_bucket(int oom_score_adj)
+{
+	return clamp(oom_score_adj, OOM_SCORE_ADJ_MIN, OOM_SCORE_ADJ_MAX) -
+		OOM_SCORE_ADJ_MIN;
+}
+
+static void __lowmem_task_add(struct task_struct *p)
+{
+	p->lowmem_score_adj = p->signal->oom_score_adj;
+	hlist_nulls_add_head_rcu(&p->lowmem_node,
+		&lowmem_index[lowmem_bucket(p->lowmem_score_adj)]);
+}
+
+/*
+ * Called with tasklist_lock held for writing on fork and exec. The node
+ * is copied from the parent, so it is reset for threads too.
+ */
+void lowmem_task_add(struct task_struct *p)
+{
+	p->lowmem_node.pprev = NULL;
+	if (!thread_group_leader(p))
+		return;
+
+	spin_lock(&lowmem_index_lock);
+	if (lowmem_index_ready)
+		__lowmem_task_add(p);
+	spin_unlock(&lowmem_index_lock);
+}
+
+void lowmem_task_del(struct task_struct *p)
+{
+	spin_lock(&lowmem_index_lock);
+	if (!hlist_nulls_unhashed(&p->lowmem_node))
+		hlist_nulls_del_init_rcu(&p->lowmem_node);
+	spin_unlock(&lowmem_index_lock);
+}
+
+/* Called with siglock held after oom_score_adj of @p was changed */
+void lowmem_task_update(struct task_struct *p)
+{
+	spin_lock(&lowmem_index_lock);
+	p = p->group_leader;
+	if (!hlist_nulls_unhashed(&p->lowmem_node) &&
+	    p->lowmem_score_adj != p->signal->oom_score_adj) {
+		hlist_nulls_del_rcu(&p->lowmem_node);
+		__lowmem_task_add(p);
+	}
+	spin_unlock(&lowmem_index_lock);
+}
+
+static void __init lowmem_index_init(void)
+{
+	int i;
+	struct task_struct *p;
+
+	for (i = 0; i < LOWMEM_INDEX_SIZE; i++)
+		INIT_HLIST_NULLS_HEAD(&lowmem_index[i], i);
+
+	/* Forks are excluded, so no process is missed or added twice */
+	read_lock(&tasklist_lock);
+	spin_lock_irq(&lowmem_index_lock);
+	for_each_process(p)
+		__lowmem_task_add(p);
+	lowmem_index_ready = true;
+	spin_unlock_irq(&lowmem_index_lock);
+	read_unlock(&tasklist_lock);
+}
+
+static bool lowmem_death_pending(struct task_struct *p)
+{
+	return test_tsk_thread_flag(p, TIF_MEMDIE) &&
+		ktime_us_delta(ktime_get(), lowmem_deathpending_timeout) < 0;
+}
+
+static int lowmem_scan(struct shrink_control *sc)
 {
 	static DEFINE_SPINLOCK(lowmem_lock);
-	struct task_struct *tsk;
+	struct task_struct *tsk, *p;
 	struct task_struct *selected = NULL;
+	struct hlist_nulls_node *pos;
+	int bucket, restarts;
 	int rem = 0;
 	int pages_can_free = 0;
 	static int same_count;
@@ -141,7 +254,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		adj_index, sleep_intervel[0], array_size,
 		sleep_intervel[adj_index]);
 	if (sleep_time > 0 && sleep_time <= SLEEP_INTERVEL_MAX &&
-		!current_is_kswapd()) {
+		!current_is_kswapd() && current != lowmem_kthread) {
 		lowmem_print(3, "sleep %ld jiffies\n", sleep_time);
 		schedule_timeout(sleep_time);
 	}
@@ -176,79 +289,72 @@ busy_count_dropped %d index %d\n",
 	}
 	/* turn of scheduling to protect task list */
 	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
 
-		if (tsk->flags & PF_KTHREAD)
-			continue;
+	/* the last victim may have left the buckets that are walked */
+	p = lastpid ? find_task_by_pid_ns(lastpid, &init_pid_ns) : NULL;
+	if (p && lowmem_death_pending(p))
+		goto waitkill;
 
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+	for (bucket = lowmem_bucket(OOM_SCORE_ADJ_MAX);
+	     bucket >= lowmem_bucket(min_score_adj) && !selected; bucket--) {
+		restarts = 0;
+restart:
+		hlist_nulls_for_each_entry_rcu(tsk, pos, &lowmem_index[bucket],
+					       lowmem_node) {
+			int oom_score_adj;
 
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-			ktime_us_delta(ktime_get(),
-				lowmem_deathpending_timeout) < 0) {
-			task_unlock(p);
-			same_count++;
-			if (p->pid != oldpid || same_count > 1000) {
-				lowmem_print(5,
-					"terminate %d (%s) oldpid:%d lastpid:%d %ld %d\n",
-					p->pid, p->comm, oldpid, lastpid,
-					(long)ktime_us_delta(ktime_get(),
-						lowmem_deathpending_timeout),
-					same_count);
-				oldpid = p->pid;
-				same_count = 0;
+			if (tsk->flags & PF_KTHREAD)
+				continue;
+
+			p = find_lock_task_mm(tsk);
+			if (!p)
+				continue;
+
+			if (lowmem_death_pending(p)) {
+				task_unlock(p);
+				goto waitkill;
 			}
-			rcu_read_unlock();
-			spin_unlock(&lowmem_lock);
-			lowmem_print(3,	"waitkill %d (%s) state:%ld flag:0x%x \
-count:%d index %d\n",
-				p->pid, p->comm, p->state, p->flags,
-				busy_count, adj_index);
-			/* wait one jiffie */
-			schedule_timeout(2);
-			return LMK_BUSY;
-		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		if (pick_task_runtime) {
-			long time_tmp = p->real_start_time.tv_sec;
-			lowmem_print(5, "ignchk task %d (%s) \
-run time %ld secs, threshold %ld secs, adj %d\n",
-				p->pid, p->comm, time_tmp,
-				pick_task_runtime, oom_score_adj);
-			if (time_tmp < pick_task_runtime) {
-				lowmem_print(3, "ignore task %d(%s) \
-run time %ld, oom_score_adj %d\n", p->pid,
-				p->comm, time_tmp, oom_score_adj);
+			oom_score_adj = p->signal->oom_score_adj;
+			if (oom_score_adj < min_score_adj) {
 				task_unlock(p);
 				continue;
 			}
-		}
+			if (pick_task_runtime) {
+				long time_tmp = p->real_start_time.tv_sec;
+				lowmem_print(5, "ignchk task %d (%s) \
+run time %ld secs, threshold %ld secs, adj %d\n",
+					p->pid, p->comm, time_tmp,
+					pick_task_runtime, oom_score_adj);
+				if (time_tmp < pick_task_runtime) {
+					lowmem_print(3, "ignore task %d(%s) \
+run time %ld, oom_score_adj %d\n", p->pid,
+					p->comm, time_tmp, oom_score_adj);
+					task_unlock(p);
+					continue;
+				}
+			}
 
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
+			tasksize = get_mm_rss(p->mm);
+			task_unlock(p);
+			if (tasksize <= 0)
 				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(3, "selected %d (%s), adj %d, \
+			if (selected) {
+				if (oom_score_adj < selected_oom_score_adj)
+					continue;
+				if (oom_score_adj == selected_oom_score_adj &&
+				    tasksize <= selected_tasksize)
+					continue;
+			}
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_score_adj = oom_score_adj;
+			lowmem_print(3, "selected %d (%s), adj %d, \
 size %d, to kill\n", p->pid, p->comm,
-			oom_score_adj, tasksize);
+				oom_score_adj, tasksize);
+		}
+		if (get_nulls_value(pos) != bucket &&
+		    restarts++ < LOWMEM_INDEX_RESTARTS)
+			goto restart;
 	}
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), \
@@ -285,8 +391,91 @@ other_file %d pages\n", other_file);
 	if (selected)
 		schedule_timeout(2);
 	return rem;
+
+waitkill:
+	same_count++;
+	if (p->pid != oldpid || same_count > 1000) {
+		lowmem_print(5,
+			"terminate %d (%s) oldpid:%d lastpid:%d %ld %d\n",
+			p->pid, p->comm, oldpid, lastpid,
+			(long)ktime_us_delta(ktime_get(),
+				lowmem_deathpending_timeout),
+			same_count);
+		oldpid = p->pid;
+		same_count = 0;
+	}
+	rcu_read_unlock();
+	spin_unlock(&lowmem_lock);
+	lowmem_print(3,	"waitkill %d (%s) state:%ld flag:0x%x \
+count:%d index %d\n",
+		p->pid, p->comm, p->state, p->flags,
+		busy_count, adj_index);
+	/* wait one jiffie */
+	schedule_timeout(2);
+	return LMK_BUSY;
 }
 
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	if (lowmem_event_mode)
+		return 0;
+
+	return lowmem_scan(sc);
+}
+
+static int lowmem_event_thread(void *data)
+{
+	struct shrink_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.nr_to_scan = 1,
+	};
+	unsigned int events;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(lowmem_event_wait,
+			(lowmem_event_mode && lowmem_triggered) ||
+			kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		events = lowmem_events;
+		if (lowmem_scan(&sc) == LMK_BUSY) {
+			/* the last victim is still exiting */
+			schedule_timeout_interruptible(2);
+			continue;
+		}
+
+		/* let reclaim tell whether that was enough */
+		if (!wait_event_interruptible_timeout(lowmem_event_wait,
+				lowmem_events != events ||
+				kthread_should_stop(), HZ))
+			lowmem_triggered = false;
+	}
+
+	return 0;
+}
+
+static int lowmem_vmpressure_notify(struct notifier_block *nb,
+				    unsigned long pressure, void *data)
+{
+	if (pressure >= lowmem_pressure_high)
+		lowmem_triggered = true;
+	else if (pressure < lowmem_pressure_low)
+		lowmem_triggered = false;
+	lowmem_print(4, "vmpressure %lu, triggered %d\n",
+		     pressure, lowmem_triggered);
+
+	lowmem_events++;
+	if (lowmem_event_mode)
+		wake_up_interruptible(&lowmem_event_wait);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call = lowmem_vmpressure_notify,
+};
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16,
@@ -295,6 +484,14 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	lowmem_index_init();
+
+	lowmem_kthread = kthread_run(lowmem_event_thread, NULL,
+				     "lowmemorykiller");
+	if (IS_ERR(lowmem_kthread))
+		return PTR_ERR(lowmem_kthread);
+
+	vmpressure_register_notifier(&lowmem_vmpressure_nb);
 	register_shrinker(&lowmem_shrinker);
 	return 0;
 }
@@ -302,6 +499,8 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	vmpressure_unregister_notifier(&lowmem_vmpressure_nb);
+	kthread_stop(lowmem_kthread);
 }
 
 #ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_AUTODETECT_OOM_ADJ_VALUES
@@ -417,6 +616,10 @@ module_param_array_named(sleep_intervel, sleep_intervel, long,
 	&sleep_intervel_size, S_IRUGO | S_IWUSR);
 module_param_named(drop_cache_intervel, drop_cache_intervel,
 		uint, S_IRUGO | S_IWUSR);
+module_param_named(event_mode, lowmem_event_mode, bool, S_IRUGO | S_IWUSR);
+module_param_named(pressure_high, lowmem_pressure_high, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_low, lowmem_pressure_low, uint, S_IRUGO | S_IWUSR);
 module_param_call(shrink_batch, set_shrink_batch, param_get_long,
 		  &shrink_batch, 0644);
 __MODULE_PARM_TYPE(shrink_batch, "long");
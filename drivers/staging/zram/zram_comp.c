@@ -0,0 +1,227 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/err.h>
+#include <linux/gfp.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_comp.h"
+
+/*
+ * Algorithms listed by the comp_algorithm sysfs node. Any other
+ * compression algorithm known to the crypto API can be selected too.
+ */
+static const char * const zram_comp_names[] = {
+	"lzo",
+	"lz4",
+	"deflate",
+	NULL
+};
+
+bool zram_comp_available(const char *name)
+{
+	return crypto_has_comp(name, 0, 0);
+}
+
+/* List the available algorithms, marking @comp as the selected one */
+ssize_t zram_comp_available_show(const char *comp, char *buf)
+{
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; zram_comp_names[i]; i++) {
+		if (!zram_comp_available(zram_comp_names[i]))
+			continue;
+		if (!strcmp(comp, zram_comp_names[i]))
+			sz += sprintf(buf + sz, "[%s] ", zram_comp_names[i]);
+		else
+			sz += sprintf(buf + sz, "%s ", zram_comp_names[i]);
+	}
+	sz += sprintf(buf + sz, "\n");
+
+	return sz;
+}
+
+static void zram_comp_strm_free(struct zram_comp_strm *zstrm)
+{
+	if (!IS_ERR_OR_NULL(zstrm->tfm))
+		crypto_free_comp(zstrm->tfm);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+static struct zram_comp_strm *zram_comp_strm_alloc(struct zram_comp *comp)
+{
+	struct zram_comp_strm *zstrm;
+
+	zstrm = kzalloc(sizeof(*zstrm), GFP_KERNEL);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->tfm = crypto_alloc_comp(comp->name, 0, 0);
+	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (IS_ERR(zstrm->tfm) || !zstrm->buffer) {
+		zram_comp_strm_free(zstrm);
+		return NULL;
+	}
+
+	return zstrm;
+}
+
+/*
+ * Take an idle stream, sleeping until one is released if all of them
+ * are in use. Streams are never allocated here: the pool is fully
+ * populated by zram_comp_create() so the write path cannot fail for
+ * lack of a stream under memory pressure.
+ */
+struct zram_comp_strm *zram_comp_strm_get(struct zram_comp *comp)
+{
+	struct zram_comp_strm *zstrm;
+
+	while (1) {
+		spin_lock(&comp->strm_lock);
+		if (!list_empty(&comp->idle_strm)) {
+			zstrm = list_first_entry(&comp->idle_strm,
+					struct zram_comp_strm, list);
+			list_del(&zstrm->list);
+			spin_unlock(&comp->strm_lock);
+			return zstrm;
+		}
+		spin_unlock(&comp->strm_lock);
+
+		wait_event(comp->strm_wait, !list_empty(&comp->idle_strm));
+	}
+}
+
+void zram_comp_strm_put(struct zram_comp *comp, struct zram_comp_strm *zstrm)
+{
+	spin_lock(&comp->strm_lock);
+	list_add(&zstrm->list, &comp->idle_strm);
+	spin_unlock(&comp->strm_lock);
+
+	wake_up(&comp->strm_wait);
+}
+
+int zram_comp_compress(struct zram_comp *comp, struct zram_comp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len)
+{
+	int ret;
+	unsigned int len = 2 * PAGE_SIZE;
+
+	ret = crypto_comp_compress(zstrm->tfm, src, PAGE_SIZE, zstrm->buffer,
+				   &len);
+	*dst_len = len;
+
+	return ret;
+}
+
+/* Does not sleep, so this can be called with the table entry locked */
+int zram_comp_decompress(struct zram_comp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst)
+{
+	int ret;
+	unsigned int dst_len = PAGE_SIZE;
+	struct crypto_comp *tfm;
+
+	tfm = *get_cpu_ptr(comp->decomp_tfm);
+	ret = crypto_comp_decompress(tfm, src, src_len, dst, &dst_len);
+	put_cpu_ptr(comp->decomp_tfm);
+
+	if (!ret && dst_len != PAGE_SIZE)
+		ret = -EINVAL;
+
+	return ret;
+}
+
+void zram_comp_destroy(struct zram_comp *comp)
+{
+	int cpu;
+	struct crypto_comp *tfm;
+	struct zram_comp_strm *zstrm;
+
+	while (!list_empty(&comp->idle_strm)) {
+		zstrm = list_first_entry(&comp->idle_strm,
+				struct zram_comp_strm, list);
+		list_del(&zstrm->list);
+		zram_comp_strm_free(zstrm);
+	}
+
+	if (comp->decomp_tfm) {
+		for_each_possible_cpu(cpu) {
+			tfm = *per_cpu_ptr(comp->decomp_tfm, cpu);
+			if (!IS_ERR_OR_NULL(tfm))
+				crypto_free_comp(tfm);
+		}
+		free_percpu(comp->decomp_tfm);
+	}
+
+	kfree(comp);
+}
+
+/*
+ * Allocate a pool of @max_strm compression streams using algorithm
+ * @name. Up to @max_strm writers can then compress pages of the same
+ * device concurrently.
+ */
+struct zram_comp *zram_comp_create(const char *name, int max_strm)
+{
+	int i, cpu;
+	struct zram_comp *comp;
+	struct zram_comp_strm *zstrm;
+	struct crypto_comp *tfm;
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return NULL;
+
+	spin_lock_init(&comp->strm_lock);
+	INIT_LIST_HEAD(&comp->idle_strm);
+	init_waitqueue_head(&comp->strm_wait);
+	comp->max_strm = max_strm;
+	strlcpy(comp->name, name, sizeof(comp->name));
+
+	comp->decomp_tfm = alloc_percpu(struct crypto_comp *);
+	if (!comp->decomp_tfm)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		tfm = crypto_alloc_comp(comp->name, 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("Error allocating %s decompressor\n",
+				comp->name);
+			goto fail;
+		}
+		*per_cpu_ptr(comp->decomp_tfm, cpu) = tfm;
+	}
+
+	for (i = 0; i < max_strm; i++) {
+		zstrm = zram_comp_strm_alloc(comp);
+		if (!zstrm)
+			goto fail;
+		list_add(&zstrm->list, &comp->idle_strm);
+	}
+
+	return comp;
+
+fail:
+	zram_comp_destroy(comp);
+	return NULL;
+}
@@ -0,0 +1,72 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#ifndef _ZRAM_COMP_H_
+#define _ZRAM_COMP_H_
+
+#include <linux/crypto.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+/* Compression algorithm used unless another one is set through sysfs */
+#define ZRAM_DEFAULT_COMP	"lzo"
+#define ZRAM_MAX_COMP_NAME	CRYPTO_MAX_ALG_NAME
+
+/*
+ * A compression stream: the algorithm instance (which owns its working
+ * memory) and output buffer needed to compress one page. A writer owns
+ * a stream exclusively from zram_comp_strm_get() until
+ * zram_comp_strm_put().
+ */
+struct zram_comp_strm {
+	struct crypto_comp *tfm;
+	/* compressed data; 2 pages since the algorithm may expand its input */
+	void *buffer;
+	struct list_head list;
+};
+
+/*
+ * Pool of compression streams shared by all writers of one device.
+ *
+ * Compression and decompression go through the crypto API, so any
+ * registered compression algorithm ("lzo", "lz4", "deflate", ...) can
+ * be used. Readers decompress with the slot lock held and cannot wait
+ * for a stream, so they use a per-cpu instance instead: algorithms such
+ * as deflate keep decompression state in the instance.
+ */
+struct zram_comp {
+	spinlock_t strm_lock;		/* protects idle_strm */
+	struct list_head idle_strm;
+	wait_queue_head_t strm_wait;	/* writers waiting for a stream */
+	int max_strm;
+	struct crypto_comp * __percpu *decomp_tfm;
+	char name[ZRAM_MAX_COMP_NAME];
+};
+
+bool zram_comp_available(const char *name);
+ssize_t zram_comp_available_show(const char *comp, char *buf);
+
+struct zram_comp *zram_comp_create(const char *name, int max_strm);
+void zram_comp_destroy(struct zram_comp *comp);
+
+struct zram_comp_strm *zram_comp_strm_get(struct zram_comp *comp);
+void zram_comp_strm_put(struct zram_comp *comp, struct zram_comp_strm *zstrm);
+
+int zram_comp_compress(struct zram_comp *comp, struct zram_comp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len);
+int zram_comp_decompress(struct zram_comp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst);
+
+#endif
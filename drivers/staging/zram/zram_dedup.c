@@ -0,0 +1,134 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+u32 zram_dedup_checksum(const unsigned char *mem)
+{
+	return jhash2((const u32 *)mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+/*
+ * Drop a reference to @entry, freeing the object once nobody uses it.
+ * Returns true if this was the last reference.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	bool last;
+
+	spin_lock(&zram->dedup_lock);
+	last = !--entry->refcount;
+	if (last)
+		rb_erase(&entry->rb_node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	if (last) {
+		zs_free(zram->mem_pool, entry->handle);
+		kfree(entry);
+	}
+
+	return last;
+}
+
+/*
+ * Look for a stored object whose uncompressed content is identical to
+ * the page at @mem. Only the first entry with a matching checksum is
+ * tried: different pages with equal checksums are rare enough that
+ * walking all of them is not worth it. @buffer is scratch space of at
+ * least PAGE_SIZE bytes.
+ *
+ * Returns the entry with a reference held, or NULL.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram,
+		const unsigned char *mem, u32 checksum, unsigned char *buffer)
+{
+	int ret;
+	struct rb_node *node;
+	struct zram_entry *entry = NULL;
+	unsigned char *cmem;
+
+	spin_lock(&zram->dedup_lock);
+	node = zram->dedup_tree.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum) {
+			entry->refcount++;
+			break;
+		}
+		node = checksum < entry->checksum ?
+			node->rb_left : node->rb_right;
+		entry = NULL;
+	}
+	spin_unlock(&zram->dedup_lock);
+
+	if (!entry)
+		return NULL;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle);
+	ret = zram_comp_decompress(zram->comp,
+			cmem + sizeof(struct zobj_header), entry->len, buffer);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	if (ret || memcmp(mem, buffer, PAGE_SIZE)) {
+		zram_dedup_put(zram, entry);
+		return NULL;
+	}
+
+	return entry;
+}
+
+/*
+ * Make the freshly stored object @handle available for deduplication.
+ * Returns its entry with a single reference, or NULL if no memory is
+ * available in which case the caller keeps using @handle directly.
+ */
+struct zram_entry *zram_dedup_insert(struct zram *zram, void *handle,
+		u16 len, u32 checksum)
+{
+	struct rb_node **p, *parent = NULL;
+	struct zram_entry *entry, *cur;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->refcount = 1;
+	entry->handle = handle;
+	entry->len = len;
+
+	spin_lock(&zram->dedup_lock);
+	p = &zram->dedup_tree.rb_node;
+	while (*p) {
+		parent = *p;
+		cur = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < cur->checksum)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, p);
+	rb_insert_color(&entry->rb_node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	return entry;
+}
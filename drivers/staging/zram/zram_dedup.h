@@ -0,0 +1,46 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/types.h>
+
+struct zram;
+
+/*
+ * A compressed object that may be shared by several table entries.
+ *
+ * When deduplication is enabled, table[index].handle of a compressed
+ * page (flagged ZRAM_DEDUP) points to one of these instead of directly
+ * to the zsmalloc object. Entries are indexed by the checksum of the
+ * uncompressed page in zram->dedup_tree.
+ */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	u32 refcount;	/* protected by zram->dedup_lock */
+	void *handle;	/* zsmalloc handle */
+	u16 len;	/* compressed size (excluding header) */
+};
+
+u32 zram_dedup_checksum(const unsigned char *mem);
+struct zram_entry *zram_dedup_find(struct zram *zram,
+		const unsigned char *mem, u32 checksum, unsigned char *buffer);
+struct zram_entry *zram_dedup_insert(struct zram *zram, void *handle,
+		u16 len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+
+#endif
@@ -23,13 +23,13 @@
 #include <linux/kernel.h>
 #include <linux/bio.h>
 #include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -42,16 +42,6 @@ struct zram *zram_devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices;
 
-static void zram_stat_inc(u32 *v)
-{
-	*v = *v + 1;
-}
-
-static void zram_stat_dec(u32 *v)
-{
-	*v = *v - 1;
-}
-
 static void zram_stat64_add(struct zram *zram, u64 *v, u64 inc)
 {
 	spin_lock(&zram->stat64_lock);
@@ -89,6 +79,21 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
+/*
+ * Table entries are protected by a bit spinlock kept in their flags
+ * word, so that I/O to different pages of one device never contends.
+ * The flag helpers above must only be used with the entry locked.
+ */
+static void zram_lock_slot(struct zram *zram, u32 index)
+{
+	bit_spin_lock(ZRAM_ACCESS, &zram->table[index].flags);
+}
+
+static void zram_unlock_slot(struct zram *zram, u32 index)
+{
+	bit_spin_unlock(ZRAM_ACCESS, &zram->table[index].flags);
+}
+
 static int page_zero_filled(void *ptr)
 {
 	unsigned int pos;
@@ -133,9 +138,22 @@ static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 	zram->disksize &= PAGE_MASK;
 }
 
+/* zsmalloc handle of a compressed page */
+static void *zram_get_handle(struct zram *zram, u32 index)
+{
+	void *handle = zram->table[index].handle;
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		return ((struct zram_entry *)handle)->handle;
+
+	return handle;
+}
+
+/* Called with the table entry locked */
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
+	bool shared = false;
 
 	if (unlikely(!handle)) {
 		/*
@@ -144,27 +162,54 @@ static void zram_free_page(struct zram *zram, size_t index)
 		 */
 		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
 			zram_clear_flag(zram, index, ZRAM_ZERO);
-			zram_stat_dec(&zram->stats.pages_zero);
+			atomic_dec(&zram->stats.pages_zero);
 		}
 		return;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_wb_free_block(zram, (unsigned long)handle);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		atomic_dec(&zram->stats.pages_wb);
+		goto out;
+	}
+
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		if (zram_test_flag(zram, index, ZRAM_WB_QUEUED)) {
+			spin_lock(&zram->wb_lock);
+			list_del(&((struct page *)handle)->lru);
+			spin_unlock(&zram->wb_lock);
+			zram_clear_flag(zram, index, ZRAM_WB_QUEUED);
+		}
 		__free_page(handle);
 		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_dec(&zram->stats.pages_expand);
+		atomic_dec(&zram->stats.pages_expand);
 		goto out;
 	}
 
-	zs_free(zram->mem_pool, handle);
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		/* Other entries may still share the object */
+		shared = !zram_dedup_put(zram, handle);
+	} else {
+		zs_free(zram->mem_pool, handle);
+	}
 
 	if (zram->table[index].size <= PAGE_SIZE / 2)
-		zram_stat_dec(&zram->stats.good_compress);
+		atomic_dec(&zram->stats.good_compress);
 
 out:
-	zram_stat64_sub(zram, &zram->stats.compr_size,
-			zram->table[index].size);
-	zram_stat_dec(&zram->stats.pages_stored);
+	if (shared)
+		zram_stat64_sub(zram, &zram->stats.dedup_saved,
+				zram->table[index].size);
+	else
+		zram_stat64_sub(zram, &zram->stats.compr_size,
+				zram->table[index].size);
+	atomic_dec(&zram->stats.pages_stored);
+
+	/* Aborts a writeback of the old content, if any */
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
 
 	zram->table[index].handle = NULL;
 	zram->table[index].size = 0;
@@ -182,56 +227,110 @@ static void handle_zero_page(struct bio_vec *bvec)
 	flush_dcache_page(page);
 }
 
-static void handle_uncompressed_page(struct zram *zram, struct bio_vec *bvec,
-				     u32 index, int offset)
+static inline int is_partial_io(struct bio_vec *bvec)
 {
-	struct page *page = bvec->bv_page;
-	unsigned char *user_mem, *cmem;
+	return bvec->bv_len != PAGE_SIZE;
+}
 
-	user_mem = kmap_atomic(page);
-	cmem = kmap_atomic(zram->table[index].handle);
+/*
+ * Decompress the page at @index into @mem. Called with the table entry
+ * locked; neither this nor anything it calls may sleep.
+ */
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+{
+	int ret;
+	void *handle;
+	struct zobj_header *zheader;
+	unsigned char *cmem;
 
-	memcpy(user_mem + bvec->bv_offset, cmem + offset, bvec->bv_len);
-	kunmap_atomic(cmem);
-	kunmap_atomic(user_mem);
+	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
+	    !zram->table[index].handle) {
+		memset(mem, 0, PAGE_SIZE);
+		return 0;
+	}
 
-	flush_dcache_page(page);
+	/* Page is stored uncompressed since it's incompressible */
+	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].handle);
+		memcpy(mem, cmem, PAGE_SIZE);
+		kunmap_atomic(cmem);
+		return 0;
+	}
+
+	handle = zram_get_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
+	ret = zram_comp_decompress(zram->comp, cmem + sizeof(*zheader),
+				   zram->table[index].size, mem);
+	zs_unmap_object(zram->mem_pool, handle);
+
+	/* Should NEVER happen. Return bio error if it does. */
+	if (unlikely(ret)) {
+		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+	}
+
+	return ret;
 }
 
-static inline int is_partial_io(struct bio_vec *bvec)
+/*
+ * Read block @blk of the backing device into @mem, or straight into
+ * @page if @mem is NULL.
+ */
+static int zram_read_from_bdev(struct zram *zram, unsigned long blk,
+			       struct page *page, char *mem)
 {
-	return bvec->bv_len != PAGE_SIZE;
+	int ret;
+	unsigned char *cmem;
+
+	if (!mem) {
+		ret = zram_wb_read(zram, blk, page);
+		goto out;
+	}
+
+	page = alloc_page(GFP_NOIO);
+	if (!page) {
+		pr_info("Error allocating temp page!\n");
+		return -ENOMEM;
+	}
+
+	ret = zram_wb_read(zram, blk, page);
+	if (!ret) {
+		cmem = kmap_atomic(page);
+		memcpy(mem, cmem, PAGE_SIZE);
+		kunmap_atomic(cmem);
+	}
+	__free_page(page);
+
+out:
+	if (unlikely(ret))
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+	else
+		zram_stat64_inc(zram, &zram->stats.bd_reads);
+	return ret;
 }
 
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
+	unsigned long blk;
 	struct page *page;
-	struct zobj_header *zheader;
-	unsigned char *user_mem, *cmem, *uncmem = NULL;
+	unsigned char *user_mem, *uncmem = NULL;
 
 	page = bvec->bv_page;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
-		return 0;
-	}
-
-	/* Requested page is not present in compressed area */
-	if (unlikely(!zram->table[index].handle)) {
-		pr_debug("Read before write: sector=%lu, size=%u",
-			 (ulong)(bio->bi_sector), bio->bi_size);
+	zram_lock_slot(zram, index);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
+	    unlikely(!zram->table[index].handle)) {
+		if (!zram_test_flag(zram, index, ZRAM_ZERO))
+			pr_debug("Read before write: sector=%lu, size=%u",
+				 (ulong)(bio->bi_sector), bio->bi_size);
+		zram_unlock_slot(zram, index);
 		handle_zero_page(bvec);
 		return 0;
 	}
-
-	/* Page is stored uncompressed since it's incompressible */
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		handle_uncompressed_page(zram, bvec, index, offset);
-		return 0;
-	}
+	zram_unlock_slot(zram, index);
 
 	if (is_partial_io(bvec)) {
 		/* Use  a temporary buffer to decompress the page */
@@ -242,32 +341,45 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		}
 	}
 
+	zram_lock_slot(zram, index);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		/*
+		 * The block is only freed if this page is overwritten or
+		 * discarded meanwhile, in which case the read races with
+		 * that anyway.
+		 */
+		blk = (unsigned long)zram->table[index].handle;
+		zram_unlock_slot(zram, index);
+
+		ret = zram_read_from_bdev(zram, blk, page, uncmem);
+		if (!ret && is_partial_io(bvec)) {
+			user_mem = kmap_atomic(page);
+			memcpy(user_mem + bvec->bv_offset, uncmem + offset,
+			       bvec->bv_len);
+			kunmap_atomic(user_mem);
+		}
+		goto out;
+	}
+
 	user_mem = kmap_atomic(page);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
-
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zram_decompress_page(zram, uncmem, index);
+	zram_unlock_slot(zram, index);
 
-	if (is_partial_io(bvec)) {
+	if (is_partial_io(bvec) && !ret)
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
 		       bvec->bv_len);
-		kfree(uncmem);
-	}
 
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
 	kunmap_atomic(user_mem);
 
-	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
-		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
-		zram_stat64_inc(zram, &zram->stats.failed_reads);
+out:
+	if (is_partial_io(bvec))
+		kfree(uncmem);
+
+	if (unlikely(ret))
 		return ret;
-	}
 
 	flush_dcache_page(page);
 
@@ -277,53 +389,214 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
-	struct zobj_header *zheader;
-	unsigned char *cmem;
+	unsigned long blk;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
-	    !zram->table[index].handle) {
-		memset(mem, 0, PAGE_SIZE);
-		return 0;
+	zram_lock_slot(zram, index);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		blk = (unsigned long)zram->table[index].handle;
+		zram_unlock_slot(zram, index);
+		return zram_read_from_bdev(zram, blk, NULL, mem);
 	}
+	ret = zram_decompress_page(zram, mem, index);
+	zram_unlock_slot(zram, index);
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
-
-	/* Page is stored uncompressed since it's incompressible */
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		memcpy(mem, cmem, PAGE_SIZE);
-		kunmap_atomic(cmem);
-		return 0;
-	}
+	return ret;
+}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
-	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
+/*
+ * Write back the copy @page of the page at @index, which the caller
+ * flagged ZRAM_UNDER_WB. Unless the page was changed meanwhile, its
+ * in-memory copy is then replaced by the block written.
+ */
+static int zram_writeback_page(struct zram *zram, u32 index,
+			       struct page *page)
+{
+	int ret = 0;
+	unsigned long blk;
 
-	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
-		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
-		zram_stat64_inc(zram, &zram->stats.failed_reads);
+	blk = zram_wb_alloc_block(zram);
+	if (!blk)
+		ret = -ENOSPC;
+	else
+		ret = zram_wb_write(zram, blk, page);
+
+	zram_lock_slot(zram, index);
+	if (ret || !zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_unlock_slot(zram, index);
+		if (blk)
+			zram_wb_free_block(zram, blk);
 		return ret;
 	}
 
+	zram_free_page(zram, index);
+	zram->table[index].handle = (void *)blk;
+	zram_set_flag(zram, index, ZRAM_WB);
+	zram_unlock_slot(zram, index);
+
+	atomic_inc(&zram->stats.pages_stored);
+	atomic_inc(&zram->stats.pages_wb);
+	zram_stat64_inc(zram, &zram->stats.bd_writes);
+
 	return 0;
 }
 
+/* Called with the table entry locked */
+static void zram_queue_writeback(struct zram *zram, u32 index,
+				 struct page *page)
+{
+	spin_lock(&zram->wb_lock);
+	set_page_private(page, index);
+	list_add_tail(&page->lru, &zram->wb_list);
+	spin_unlock(&zram->wb_lock);
+	zram_set_flag(zram, index, ZRAM_WB_QUEUED);
+
+	queue_delayed_work(zram_wb_wq, &zram->wb_work, 0);
+}
+
+/*
+ * Write back the incompressible pages queued by zram_bvec_write(). They
+ * stay readable from memory until their write completes.
+ */
+static void zram_writeback_work(struct work_struct *work)
+{
+	u32 index;
+	struct page *page;
+	struct zram *zram = container_of(to_delayed_work(work), struct zram,
+					 wb_work);
+
+	/*
+	 * Reset cancels this work while holding init_lock for writing.
+	 * Other writers release it soon, so try again a bit later rather
+	 * than spinning on the workqueue.
+	 */
+	if (!down_read_trylock(&zram->init_lock)) {
+		queue_delayed_work(zram_wb_wq, &zram->wb_work,
+				   ZRAM_WB_RETRY_DELAY);
+		return;
+	}
+
+	while (zram->init_done) {
+		spin_lock(&zram->wb_lock);
+		if (list_empty(&zram->wb_list)) {
+			spin_unlock(&zram->wb_lock);
+			break;
+		}
+		page = list_first_entry(&zram->wb_list, struct page, lru);
+		index = page_private(page);
+		spin_unlock(&zram->wb_lock);
+
+		/* The page may be freed once wb_lock is dropped: recheck */
+		zram_lock_slot(zram, index);
+		if (!zram_test_flag(zram, index, ZRAM_WB_QUEUED)) {
+			zram_unlock_slot(zram, index);
+			continue;
+		}
+		page = zram->table[index].handle;
+		spin_lock(&zram->wb_lock);
+		list_del(&page->lru);
+		spin_unlock(&zram->wb_lock);
+		zram_clear_flag(zram, index, ZRAM_WB_QUEUED);
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		/* Keep the page until its write completes */
+		get_page(page);
+		zram_unlock_slot(zram, index);
+
+		zram_writeback_page(zram, index, page);
+		put_page(page);
+	}
+
+	up_read(&zram->init_lock);
+}
+
+/*
+ * Runs every idle_writeback_secs. Pages that were not accessed since the
+ * previous run are written back, all others are marked idle. Shared
+ * dedup objects stay in memory as the other users may not be idle.
+ */
+static void zram_idle_work(struct work_struct *work)
+{
+	int ret;
+	u32 index;
+	void *handle;
+	unsigned char *mem;
+	struct page *page;
+	struct zram *zram = container_of(to_delayed_work(work), struct zram,
+					 idle_work);
+
+	/* See zram_writeback_work() */
+	if (!down_read_trylock(&zram->init_lock))
+		goto resched;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!zram->init_done || !page)
+		goto out;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		zram_lock_slot(zram, index);
+		handle = zram->table[index].handle;
+		if (!handle || zram_test_flag(zram, index, ZRAM_WB) ||
+		    zram_test_flag(zram, index, ZRAM_WB_QUEUED) ||
+		    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+			goto next;
+
+		if (!zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_set_flag(zram, index, ZRAM_IDLE);
+			goto next;
+		}
+
+		if (zram_test_flag(zram, index, ZRAM_DEDUP) &&
+		    ((struct zram_entry *)handle)->refcount > 1)
+			goto next;
+
+		mem = kmap_atomic(page);
+		ret = zram_decompress_page(zram, mem, index);
+		kunmap_atomic(mem);
+		if (ret)
+			goto next;
+
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		zram_unlock_slot(zram, index);
+
+		/* Stop writing back once the backing device is full */
+		if (zram_writeback_page(zram, index, page) == -ENOSPC)
+			break;
+		cond_resched();
+		continue;
+next:
+		zram_unlock_slot(zram, index);
+		cond_resched();
+	}
+
+out:
+	if (page)
+		__free_page(page);
+	up_read(&zram->init_lock);
+resched:
+	if (zram->idle_writeback_secs)
+		queue_delayed_work(zram_wb_wq, &zram->idle_work,
+				   zram->idle_writeback_secs * HZ);
+}
+
+/*
+ * Compression and allocation of the new object happen without any lock
+ * held, using a compression stream owned by this writer. The table entry
+ * is locked only to swap the new object in and release the old one.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret;
-	u32 store_offset;
+	u32 checksum = 0;
 	size_t clen;
 	void *handle;
 	struct zobj_header *zheader;
-	struct page *page, *page_store;
+	struct page *page, *page_store = NULL;
+	struct zram_comp_strm *zstrm = NULL;
+	struct zram_entry *entry = NULL;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -337,46 +610,53 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 		ret = zram_read_before_write(zram, uncmem, index);
-		if (ret) {
-			kfree(uncmem);
+		if (ret)
 			goto out;
-		}
-	}
-
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
 
-	user_mem = kmap_atomic(page);
-
-	if (is_partial_io(bvec))
+		user_mem = kmap_atomic(page);
 		memcpy(uncmem + offset, user_mem + bvec->bv_offset,
 		       bvec->bv_len);
-	else
-		uncmem = user_mem;
+		kunmap_atomic(user_mem);
+	}
 
-	if (page_zero_filled(uncmem)) {
+	user_mem = kmap_atomic(page);
+	src = is_partial_io(bvec) ? uncmem : user_mem;
+	if (page_zero_filled(src)) {
 		kunmap_atomic(user_mem);
-		if (is_partial_io(bvec))
-			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
+		zram_lock_slot(zram, index);
+		zram_free_page(zram, index);
 		zram_set_flag(zram, index, ZRAM_ZERO);
+		zram_unlock_slot(zram, index);
+		atomic_inc(&zram->stats.pages_zero);
 		ret = 0;
 		goto out;
 	}
+	kunmap_atomic(user_mem);
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	/* May sleep until another writer releases its stream */
+	zstrm = zram_comp_strm_get(zram->comp);
 
+	user_mem = kmap_atomic(page);
+	src = is_partial_io(bvec) ? uncmem : user_mem;
+
+	if (zram->use_dedup) {
+		checksum = zram_dedup_checksum(src);
+		entry = zram_dedup_find(zram, src, checksum, zstrm->buffer);
+		if (entry) {
+			kunmap_atomic(user_mem);
+			zram_stat64_inc(zram, &zram->stats.dedup_hits);
+			zram_stat64_add(zram, &zram->stats.dedup_saved,
+					entry->len);
+			handle = entry;
+			clen = entry->len;
+			goto memstored;
+		}
+	}
+
+	ret = zram_comp_compress(zram->comp, zstrm, src, &clen);
 	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-			kfree(uncmem);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
@@ -396,13 +676,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
 		handle = page_store;
-		src = kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
-		goto memstore;
+		user_mem = kmap_atomic(page);
+		src = is_partial_io(bvec) ? uncmem : user_mem;
+		memcpy(cmem, src, clen);
+		kunmap_atomic(user_mem);
+		kunmap_atomic(cmem);
+		goto memstored;
 	}
 
 	handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
@@ -414,37 +695,55 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	}
 	cmem = zs_map_object(zram->mem_pool, handle);
 
-memstore:
-#if 0
 	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
-#endif
+	zheader = (struct zobj_header *)cmem;
+	zheader->table_idx = index;
+	cmem += sizeof(*zheader);
 
-	memcpy(cmem, src, clen);
+	memcpy(cmem, zstrm->buffer, clen);
+	zs_unmap_object(zram->mem_pool, handle);
 
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		kunmap_atomic(cmem);
-		kunmap_atomic(src);
-	} else {
-		zs_unmap_object(zram->mem_pool, handle);
+	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+	if (zram->use_dedup) {
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+		if (entry)
+			handle = entry;
 	}
 
+memstored:
+	zram_comp_strm_put(zram->comp, zstrm);
+	zstrm = NULL;
+
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	zram_lock_slot(zram, index);
+	zram_free_page(zram, index);
 	zram->table[index].handle = handle;
 	zram->table[index].size = clen;
+	if (page_store) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		if (zram->bdev)
+			zram_queue_writeback(zram, index, page_store);
+	}
+	if (entry)
+		zram_set_flag(zram, index, ZRAM_DEDUP);
+	zram_unlock_slot(zram, index);
 
 	/* Update stats */
-	zram_stat64_add(zram, &zram->stats.compr_size, clen);
-	zram_stat_inc(&zram->stats.pages_stored);
-	if (clen <= PAGE_SIZE / 2)
-		zram_stat_inc(&zram->stats.good_compress);
-
-	return 0;
+	atomic_inc(&zram->stats.pages_stored);
+	if (page_store) {
+		zram_stat64_add(zram, &zram->stats.compr_size, clen);
+		atomic_inc(&zram->stats.pages_expand);
+	} else if (clen <= PAGE_SIZE / 2) {
+		atomic_inc(&zram->stats.good_compress);
+	}
 
 out:
+	if (zstrm)
+		zram_comp_strm_put(zram->comp, zstrm);
+	kfree(uncmem);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
@@ -455,15 +754,10 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret;
 
-	if (rw == READ) {
-		down_read(&zram->lock);
+	if (rw == READ)
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
-	} else {
-		down_write(&zram->lock);
+	else
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
-	}
 
 	return ret;
 }
@@ -577,35 +871,121 @@ error:
 	bio_io_error(bio);
 }
 
+/*
+ * zsmalloc compaction callbacks, see struct zs_ops. The table entry of
+ * an object is found through its zobj_header. Dedup objects are moved
+ * only while the entry has a single reference, held by that table entry;
+ * dedup_lock is then kept until zram_zs_migrate() so that
+ * zram_dedup_find() can't pick the object up meanwhile. Shared objects
+ * stay in place.
+ */
+static bool zram_zs_isolate(void *private, void *handle)
+{
+	u32 index;
+	struct zobj_header *zheader;
+	struct zram_entry *entry;
+	struct zram *zram = private;
+
+	/* Keeps reset from freeing the table under us */
+	if (!down_read_trylock(&zram->init_lock))
+		return false;
+
+	zheader = zs_map_object(zram->mem_pool, handle);
+	index = zheader->table_idx;
+	zs_unmap_object(zram->mem_pool, handle);
+
+	/* Objects not stored in the table yet have no valid header */
+	if (index >= zram->disksize >> PAGE_SHIFT ||
+	    !bit_spin_trylock(ZRAM_ACCESS, &zram->table[index].flags))
+		goto fail;
+
+	if (zram_test_flag(zram, index, ZRAM_UNCOMPRESSED) ||
+	    zram_test_flag(zram, index, ZRAM_WB))
+		goto fail_unlock;
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		entry = zram->table[index].handle;
+		spin_lock(&zram->dedup_lock);
+		if (entry->handle != handle || entry->refcount != 1) {
+			spin_unlock(&zram->dedup_lock);
+			goto fail_unlock;
+		}
+	} else if (zram->table[index].handle != handle) {
+		goto fail_unlock;
+	}
+
+	return true;
+
+fail_unlock:
+	zram_unlock_slot(zram, index);
+fail:
+	up_read(&zram->init_lock);
+	return false;
+}
+
+static void zram_zs_migrate(void *private, void *old, void *new)
+{
+	u32 index;
+	struct zobj_header *zheader;
+	struct zram_entry *entry;
+	struct zram *zram = private;
+
+	zheader = zs_map_object(zram->mem_pool, new);
+	index = zheader->table_idx;
+	zs_unmap_object(zram->mem_pool, new);
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		entry = zram->table[index].handle;
+		entry->handle = new;
+		spin_unlock(&zram->dedup_lock);
+	} else {
+		zram->table[index].handle = new;
+	}
+	zram_unlock_slot(zram, index);
+	up_read(&zram->init_lock);
+}
+
+static struct zs_ops zram_zs_ops = {
+	.isolate = zram_zs_isolate,
+	.migrate = zram_zs_migrate,
+};
+
 void __zram_reset_device(struct zram *zram)
 {
 	size_t index;
 
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
+	cancel_delayed_work_sync(&zram->idle_work);
+	cancel_delayed_work_sync(&zram->wb_work);
 
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	/* Free various per-device buffers */
+	if (zram->comp)
+		zram_comp_destroy(zram->comp);
+	zram->comp = NULL;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		void *handle = zram->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
 			__free_page(handle);
+		else if (zram_test_flag(zram, index, ZRAM_DEDUP))
+			zram_dedup_put(zram, handle);
 		else
 			zs_free(zram->mem_pool, handle);
 	}
+	zram->dedup_tree = RB_ROOT;
+	INIT_LIST_HEAD(&zram->wb_list);
+	zram_wb_close(zram);
 
 	vfree(zram->table);
 	zram->table = NULL;
 
-	zs_destroy_pool(zram->mem_pool);
+	if (zram->mem_pool)
+		zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
 	/* Reset stats */
@@ -635,17 +1015,11 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
+	zram->comp = zram_comp_create(zram->compressor,
+				      zram->max_comp_streams);
+	if (!zram->comp) {
+		pr_err("Error allocating %d %s compression streams\n",
+			zram->max_comp_streams, zram->compressor);
 		ret = -ENOMEM;
 		goto fail_no_table;
 	}
@@ -663,7 +1037,8 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM,
+					&zram_zs_ops, zram);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
@@ -671,6 +1046,9 @@ int zram_init_device(struct zram *zram)
 	}
 
 	zram->init_done = 1;
+	if (zram->bdev && zram->idle_writeback_secs)
+		queue_delayed_work(zram_wb_wq, &zram->idle_work,
+				   zram->idle_writeback_secs * HZ);
 	up_write(&zram->init_lock);
 
 	pr_debug("Initialization done!\n");
@@ -692,7 +1070,9 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
+	zram_lock_slot(zram, index);
 	zram_free_page(zram, index);
+	zram_unlock_slot(zram, index);
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -705,9 +1085,17 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
 
-	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	spin_lock_init(&zram->dedup_lock);
+	zram->dedup_tree = RB_ROOT;
+	spin_lock_init(&zram->bitmap_lock);
+	spin_lock_init(&zram->wb_lock);
+	INIT_LIST_HEAD(&zram->wb_list);
+	INIT_DELAYED_WORK(&zram->wb_work, zram_writeback_work);
+	INIT_DELAYED_WORK(&zram->idle_work, zram_idle_work);
+	zram->max_comp_streams = num_possible_cpus();
+	strlcpy(zram->compressor, ZRAM_DEFAULT_COMP, sizeof(zram->compressor));
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -795,11 +1183,17 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	ret = zram_wb_init();
+	if (ret) {
+		pr_warning("Unable to create writeback workqueue\n");
+		goto out;
+	}
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warning("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto free_wq;
 	}
 
 	if (!num_devices) {
@@ -829,6 +1223,8 @@ free_devices:
 	kfree(zram_devices);
 unregister:
 	unregister_blkdev(zram_major, "zram");
+free_wq:
+	zram_wb_exit();
 out:
 	return ret;
 }
@@ -844,9 +1240,11 @@ static void __exit zram_exit(void)
 		destroy_device(zram);
 		if (zram->init_done)
 			zram_reset_device(zram);
+		zram_wb_close(zram);
 	}
 
 	unregister_blkdev(zram_major, "zram");
+	zram_wb_exit();
 
 	kfree(zram_devices);
 	pr_debug("Cleanup done!\n");
@@ -19,6 +19,9 @@
 #include <linux/mutex.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zram_comp.h"
+#include "zram_dedup.h"
+#include "zram_wb.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -30,12 +33,11 @@ static const unsigned max_num_devices = 32;
  * Stored at beginning of each compressed object.
  *
  * It stores back-reference to table entry which points to this
- * object. This is required to support memory defragmentation.
+ * object. This is required to support memory defragmentation
+ * (see zs_compact()).
  */
 struct zobj_header {
-#if 0
 	u32 table_idx;
-#endif
 };
 
 /*-- Configurable parameters */
@@ -66,6 +68,9 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
+/* Backoff before writeback retries while init_lock is write-held */
+#define ZRAM_WB_RETRY_DELAY	(HZ / 10)
+
 /* Flags for zram pages (table[page_no].flags) */
 enum zram_pageflags {
 	/* Page is stored uncompressed */
@@ -74,6 +79,24 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* handle points to a (possibly shared) struct zram_entry */
+	ZRAM_DEDUP,
+
+	/* Table entry is locked (bit spinlock) */
+	ZRAM_ACCESS,
+
+	/* Page is on the backing device; handle is its block number */
+	ZRAM_WB,
+
+	/* Uncompressed page waiting on zram->wb_list to be written back */
+	ZRAM_WB_QUEUED,
+
+	/* A copy of the page is being written back */
+	ZRAM_UNDER_WB,
+
+	/* Page was not accessed since the last idle writeback pass */
+	ZRAM_IDLE,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
@@ -82,9 +105,13 @@ enum zram_pageflags {
 /* Allocated for each disk page */
 struct table {
 	void *handle;
+	/*
+	 * zram_pageflags. Also holds the ZRAM_ACCESS bit spinlock which
+	 * serializes all accesses to this entry, hence unsigned long.
+	 */
+	unsigned long flags;
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
-	u8 flags;
 } __attribute__((aligned(4)));
 
 struct zram_stats {
@@ -95,30 +122,57 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
-	u32 pages_zero;		/* no. of zero filled pages */
-	u32 pages_stored;	/* no. of pages currently stored */
-	u32 good_compress;	/* % of pages with compression ratio<=50% */
-	u32 pages_expand;	/* % of incompressible pages */
+	u64 dedup_hits;		/* writes that found an identical page */
+	u64 dedup_saved;	/* compressed bytes shared thanks to dedup */
+	u64 bd_reads;		/* pages read from the backing device */
+	u64 bd_writes;		/* pages written to the backing device */
+	atomic_t pages_zero;	/* no. of zero filled pages */
+	atomic_t pages_stored;	/* no. of pages currently stored */
+	atomic_t good_compress;	/* % of pages with compression ratio<=50% */
+	atomic_t pages_expand;	/* % of incompressible pages */
+	atomic_t pages_wb;	/* no. of pages on the backing device */
 };
 
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zram_comp *comp;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
 	/* Prevent concurrent execution of device init, reset and R/W request */
 	struct rw_semaphore init_lock;
+	/* Deduplicate identical pages; can only be set before init */
+	bool use_dedup;
+	spinlock_t dedup_lock;	/* protects dedup_tree and entry refcounts */
+	struct rb_root dedup_tree;
 	/*
 	 * This is the limit on amount of *uncompressed* worth of data
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	/* Number of pages that can be compressed concurrently */
+	int max_comp_streams;
+	/* Compression algorithm, see zram_comp.c */
+	char compressor[ZRAM_MAX_COMP_NAME];
+
+	/* Backing device, see zram_wb.c; can only be set before init */
+	struct block_device *bdev;
+	char *backing_dev;
+	unsigned long *bitmap;	/* allocated blocks of bdev */
+	unsigned long nr_blocks;
+	spinlock_t bitmap_lock;
+	/*
+	 * Incompressible pages waiting to be written back, linked through
+	 * page->lru. Nests inside the table entry lock.
+	 */
+	spinlock_t wb_lock;
+	struct list_head wb_list;
+	struct delayed_work wb_work;
+	/* Write back pages not accessed for this long; 0 disables it */
+	unsigned int idle_writeback_secs;
+	struct delayed_work idle_work;
 
 	struct zram_stats stats;
 };
@@ -0,0 +1,222 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/completion.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+#define ZRAM_WB_MODE	(FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+/* Runs writeback and backing device reads of all devices */
+struct workqueue_struct *zram_wb_wq;
+
+int zram_wb_init(void)
+{
+	zram_wb_wq = alloc_workqueue("zram_wb", WQ_MEM_RECLAIM, 0);
+	if (!zram_wb_wq)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void zram_wb_exit(void)
+{
+	destroy_workqueue(zram_wb_wq);
+}
+
+/*
+ * Use the block device at @path as backing device, replacing the
+ * current one. Called with init_lock held, before the device is
+ * initialized. Files can be used through a loop device.
+ */
+int zram_wb_open(struct zram *zram, const char *path)
+{
+	int ret;
+	char *name;
+	unsigned long nr_blocks, *bitmap;
+	struct block_device *bdev;
+
+	name = kstrdup(path, GFP_KERNEL);
+	if (!name)
+		return -ENOMEM;
+
+	bdev = blkdev_get_by_path(path, ZRAM_WB_MODE, zram);
+	if (IS_ERR(bdev)) {
+		ret = PTR_ERR(bdev);
+		goto fail_free;
+	}
+
+	ret = set_blocksize(bdev, PAGE_SIZE);
+	if (ret)
+		goto fail_put;
+
+	nr_blocks = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (nr_blocks < 2) {
+		ret = -EINVAL;
+		goto fail_put;
+	}
+
+	bitmap = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!bitmap) {
+		ret = -ENOMEM;
+		goto fail_put;
+	}
+
+	zram_wb_close(zram);
+
+	zram->bdev = bdev;
+	zram->backing_dev = name;
+	zram->bitmap = bitmap;
+	zram->nr_blocks = nr_blocks;
+
+	return 0;
+
+fail_put:
+	blkdev_put(bdev, ZRAM_WB_MODE);
+fail_free:
+	kfree(name);
+	return ret;
+}
+
+void zram_wb_close(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, ZRAM_WB_MODE);
+	zram->bdev = NULL;
+
+	kfree(zram->backing_dev);
+	zram->backing_dev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_blocks = 0;
+}
+
+/* Returns a free block, or 0 if the backing device is full */
+unsigned long zram_wb_alloc_block(struct zram *zram)
+{
+	unsigned long blk;
+
+	spin_lock(&zram->bitmap_lock);
+	blk = find_next_zero_bit(zram->bitmap, zram->nr_blocks, 1);
+	if (blk < zram->nr_blocks)
+		__set_bit(blk, zram->bitmap);
+	else
+		blk = 0;
+	spin_unlock(&zram->bitmap_lock);
+
+	return blk;
+}
+
+void zram_wb_free_block(struct zram *zram, unsigned long blk)
+{
+	spin_lock(&zram->bitmap_lock);
+	WARN_ON(!__test_and_clear_bit(blk, zram->bitmap));
+	spin_unlock(&zram->bitmap_lock);
+}
+
+static void zram_wb_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+static int zram_wb_rw(struct zram *zram, unsigned long blk,
+		struct page *page, int rw)
+{
+	int ret = 0;
+	struct bio *bio;
+	DECLARE_COMPLETION_ONSTACK(done);
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_end_io = zram_wb_end_io;
+	bio->bi_private = &done;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags)) {
+		pr_err("Backing device %s error at block %lu\n",
+			rw == READ ? "read" : "write", blk);
+		ret = -EIO;
+	}
+	bio_put(bio);
+
+	return ret;
+}
+
+struct zram_wb_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long blk;
+	struct page *page;
+	int ret;
+};
+
+static void zram_wb_read_fn(struct work_struct *work)
+{
+	struct zram_wb_read_work *rw;
+
+	rw = container_of(work, struct zram_wb_read_work, work);
+	rw->ret = zram_wb_rw(rw->zram, rw->blk, rw->page, READ);
+}
+
+/*
+ * Read block @blk into @page. Called from zram_make_request(), where a
+ * bio submitted to another device is only dispatched after we return
+ * (see generic_make_request()), so waiting for it would deadlock. The
+ * read is issued from the workqueue instead.
+ */
+int zram_wb_read(struct zram *zram, unsigned long blk, struct page *page)
+{
+	struct zram_wb_read_work rw = {
+		.zram = zram,
+		.blk = blk,
+		.page = page,
+	};
+
+	INIT_WORK_ONSTACK(&rw.work, zram_wb_read_fn);
+	queue_work(zram_wb_wq, &rw.work);
+	flush_work(&rw.work);
+	destroy_work_on_stack(&rw.work);
+
+	return rw.ret;
+}
+
+/* Write @page to block @blk. Only called from the workqueue. */
+int zram_wb_write(struct zram *zram, unsigned long blk, struct page *page)
+{
+	return zram_wb_rw(zram, blk, page, WRITE);
+}
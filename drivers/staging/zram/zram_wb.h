@@ -0,0 +1,46 @@
+/*
+ * Compressed RAM block device
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#ifndef _ZRAM_WB_H_
+#define _ZRAM_WB_H_
+
+#include <linux/mm_types.h>
+#include <linux/workqueue.h>
+
+struct zram;
+
+/*
+ * Writeback to a backing device.
+ *
+ * Incompressible pages, and pages that were not accessed for a while,
+ * can be written to a block device set through the backing_dev sysfs
+ * node. The device is split into PAGE_SIZE blocks, tracked by a bitmap;
+ * table[index].handle of a written back page (flagged ZRAM_WB) holds its
+ * block number. Block 0 is never used so that handle is never NULL.
+ */
+extern struct workqueue_struct *zram_wb_wq;
+
+int zram_wb_init(void);
+void zram_wb_exit(void);
+
+int zram_wb_open(struct zram *zram, const char *path);
+void zram_wb_close(struct zram *zram);
+
+unsigned long zram_wb_alloc_block(struct zram *zram);
+void zram_wb_free_block(struct zram *zram, unsigned long blk);
+
+int zram_wb_read(struct zram *zram, unsigned long blk, struct page *page);
+int zram_wb_write(struct zram *zram, unsigned long blk, struct page *page);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * zsmalloc micro-benchmark
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the license that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Measures the average latency of zs_malloc(), zs_map_object() +
+ * zs_unmap_object() and zs_free() for every size class. The results are
+ * printed when the module is loaded, e.g:
+ *
+ *	modprobe zsmalloc-bench nr_objs=4096
+ *	dmesg | grep zsmalloc-bench
+ *
+ * Loading always fails so that the benchmark can simply be run again.
+ */
+
+#define KMSG_COMPONENT "zsmalloc-bench"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/gfp.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zsmalloc.h"
+#include "zsmalloc_int.h"
+
+static unsigned int nr_objs = 1024;
+
+struct zs_bench_result {
+	u64 malloc_ns;
+	u64 map_ns;
+	u64 free_ns;
+};
+
+static u64 zs_bench_per_obj(ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	do_div(ns, nr_objs);
+	return ns;
+}
+
+static int zs_bench_class(struct zs_pool *pool, void **handles, int size,
+			struct zs_bench_result *res)
+{
+	unsigned int i;
+	ktime_t start;
+	void *obj;
+
+	start = ktime_get();
+	for (i = 0; i < nr_objs; i++) {
+		handles[i] = zs_malloc(pool, size);
+		if (!handles[i])
+			goto fail;
+	}
+	res->malloc_ns = zs_bench_per_obj(start);
+
+	start = ktime_get();
+	for (i = 0; i < nr_objs; i++) {
+		obj = zs_map_object(pool, handles[i]);
+		memset(obj, i, size);
+		zs_unmap_object(pool, handles[i]);
+	}
+	res->map_ns = zs_bench_per_obj(start);
+
+	start = ktime_get();
+	for (i = 0; i < nr_objs; i++)
+		zs_free(pool, handles[i]);
+	res->free_ns = zs_bench_per_obj(start);
+
+	return 0;
+
+fail:
+	while (i--)
+		zs_free(pool, handles[i]);
+	return -ENOMEM;
+}
+
+static int __init zs_bench_init(void)
+{
+	int i, size, ret = 0;
+	void **handles;
+	struct zs_pool *pool;
+	struct zs_bench_result res, total;
+
+	if (!nr_objs)
+		return -EINVAL;
+
+	handles = vmalloc(nr_objs * sizeof(*handles));
+	if (!handles)
+		return -ENOMEM;
+
+	pool = zs_create_pool("zsmalloc-bench", GFP_KERNEL | __GFP_HIGHMEM,
+			NULL, NULL);
+	if (!pool) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	memset(&total, 0, sizeof(total));
+	pr_info("%u objects per class, average ns per operation:\n", nr_objs);
+	pr_info(" size   malloc  map+unmap     free\n");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		size = min_t(int, ZS_MIN_ALLOC_SIZE + i * ZS_SIZE_CLASS_DELTA,
+			     ZS_MAX_ALLOC_SIZE);
+		ret = zs_bench_class(pool, handles, size, &res);
+		if (ret) {
+			pr_err("Error allocating %u objects of size %d\n",
+				nr_objs, size);
+			break;
+		}
+
+		pr_info("%5d %8llu %10llu %8llu\n", size,
+			res.malloc_ns, res.map_ns, res.free_ns);
+		total.malloc_ns += res.malloc_ns;
+		total.map_ns += res.map_ns;
+		total.free_ns += res.free_ns;
+
+		cond_resched();
+	}
+
+	if (!ret) {
+		do_div(total.malloc_ns, ZS_SIZE_CLASSES);
+		do_div(total.map_ns, ZS_SIZE_CLASSES);
+		do_div(total.free_ns, ZS_SIZE_CLASSES);
+		pr_info("  avg %8llu %10llu %8llu\n",
+			total.malloc_ns, total.map_ns, total.free_ns);
+	}
+
+	zs_destroy_pool(pool);
+out:
+	vfree(handles);
+
+	/* Don't stay loaded: the benchmark runs once per load */
+	return ret ? ret : -EAGAIN;
+}
+
+static void __exit zs_bench_exit(void) { }
+
+module_init(zs_bench_init);
+module_exit(zs_bench_exit);
+
+module_param(nr_objs, uint, 0);
+MODULE_PARM_DESC(nr_objs, "Number of objects allocated per size class");
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("zsmalloc micro-benchmark");
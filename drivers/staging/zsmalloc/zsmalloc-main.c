@@ -425,6 +425,291 @@ static struct page *find_get_zspage(struct size_class *class)
 	return page;
 }
 
+/* Take a free object from the given zspage. Called with the class locked */
+static void *obj_malloc(struct page *first_page, struct size_class *class)
+{
+	void *obj;
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long m_objidx, m_offset;
+
+	obj = first_page->freelist;
+	obj_handle_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	link = (struct link_free *)kmap_atomic(m_page) +
+					m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	memset(link, POISON_INUSE, sizeof(*link));
+	kunmap_atomic(link);
+
+	first_page->inuse++;
+	class->objs_inuse++;
+
+	return obj;
+}
+
+/* Return an object to its zspage. Called with the class locked */
+static void obj_free(struct page *first_page, struct size_class *class,
+			void *obj)
+{
+	struct link_free *link;
+	struct page *f_page;
+	unsigned long f_objidx, f_offset;
+
+	obj_handle_to_location(obj, &f_page, &f_objidx);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	/* Insert this object in containing zspage's freelist */
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
+							+ f_offset);
+	link->next = first_page->freelist;
+	kunmap_atomic(link);
+	first_page->freelist = obj;
+
+	first_page->inuse--;
+	class->objs_inuse--;
+}
+
+/*
+ * Copy object @src to @dst. Either of them may span two pages, so this
+ * maps one page of each at a time rather than using zs_map_object().
+ */
+static void obj_copy(void *dst, void *src, struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_objidx, d_objidx, s_off, d_off;
+	unsigned char *s_addr, *d_addr;
+	int len, copied = 0;
+
+	obj_handle_to_location(src, &s_page, &s_objidx);
+	obj_handle_to_location(dst, &d_page, &d_objidx);
+	s_off = obj_idx_to_offset(s_page, s_objidx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_objidx, class->size);
+
+	while (1) {
+		len = min3(PAGE_SIZE - s_off, PAGE_SIZE - d_off,
+			   (unsigned long)(class->size - copied));
+
+		s_addr = kmap_atomic(s_page);
+		d_addr = kmap_atomic(d_page);
+		memcpy(d_addr + d_off, s_addr + s_off, len);
+		kunmap_atomic(d_addr);
+		kunmap_atomic(s_addr);
+
+		copied += len;
+		if (copied == class->size)
+			break;
+
+		s_off += len;
+		d_off += len;
+		if (s_off == PAGE_SIZE) {
+			s_page = get_next_page(s_page);
+			s_off = 0;
+		}
+		if (d_off == PAGE_SIZE) {
+			d_page = get_next_page(d_page);
+			d_off = 0;
+		}
+	}
+}
+
+/* Offset of the first object starting in the given page of a zspage */
+static unsigned long first_obj_offset(struct page *page)
+{
+	return is_first_page(page) ? 0 : page->index;
+}
+
+/* Position of an object among those starting in its zspage */
+static unsigned int obj_number(void *obj, struct size_class *class)
+{
+	struct page *page, *o_page;
+	unsigned long obj_idx;
+	unsigned int nr = 0;
+
+	obj_handle_to_location(obj, &o_page, &obj_idx);
+	for (page = get_first_page(o_page); page != o_page;
+			page = get_next_page(page))
+		nr += DIV_ROUND_UP(PAGE_SIZE - first_obj_offset(page),
+				   class->size);
+
+	return nr + obj_idx;
+}
+
+/*
+ * Move all objects of @first_page, which is not on any fullness list, to
+ * other zspages of the class. Called with the class locked.
+ *
+ * Returns 0 once the zspage is empty, -EBUSY if its owner refused to
+ * give up one of the objects, or -ENOSPC if no other zspage has room.
+ */
+static int migrate_zspage(struct zs_pool *pool, struct size_class *class,
+				struct page *first_page)
+{
+	DECLARE_BITMAP(free_objs, ZS_MAX_OBJS_PER_ZSPAGE);
+	struct link_free *link;
+	struct page *page, *f_page, *dst_page;
+	unsigned long off, obj_idx, f_objidx, f_offset;
+	unsigned int nr = 0;
+	void *obj, *new_obj;
+
+	/* Find out which objects are allocated */
+	bitmap_zero(free_objs, ZS_MAX_OBJS_PER_ZSPAGE);
+	obj = first_page->freelist;
+	while (obj) {
+		__set_bit(obj_number(obj, class), free_objs);
+
+		obj_handle_to_location(obj, &f_page, &f_objidx);
+		f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+		link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
+								+ f_offset);
+		obj = link->next;
+		kunmap_atomic(link);
+	}
+
+	for (page = first_page; page; page = get_next_page(page)) {
+		obj_idx = 0;
+		for (off = first_obj_offset(page); off < PAGE_SIZE;
+				off += class->size, obj_idx++, nr++) {
+			if (!first_page->inuse)
+				return 0;
+			if (test_bit(nr, free_objs))
+				continue;
+
+			dst_page = find_get_zspage(class);
+			if (!dst_page)
+				return -ENOSPC;
+
+			obj = obj_location_to_handle(page, obj_idx);
+			if (!pool->ops->isolate(pool->private, obj))
+				return -EBUSY;
+
+			new_obj = obj_malloc(dst_page, class);
+			fix_fullness_group(pool, dst_page);
+			obj_copy(new_obj, obj, class);
+			pool->ops->migrate(pool->private, obj, new_obj);
+			obj_free(first_page, class, obj);
+		}
+	}
+
+	return 0;
+}
+
+/* Number of zspages of the class that compaction could free */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long objs_per_zspage, objs_allocated;
+
+	objs_per_zspage = class->zspage_order * PAGE_SIZE / class->size;
+	objs_allocated = (unsigned long)class->pages_allocated /
+				class->zspage_order * objs_per_zspage;
+	/* The shrinker reads these without the class lock */
+	if (objs_allocated <= class->objs_inuse)
+		return 0;
+
+	return (objs_allocated - class->objs_inuse) / objs_per_zspage;
+}
+
+/* Compacts @class until @nr_pages pages were freed or nothing is left */
+static unsigned long zs_compact_class(struct zs_pool *pool,
+					struct size_class *class,
+					unsigned long nr_pages)
+{
+	int ret;
+	unsigned long nr_src, pages_freed = 0;
+	struct page *first_page, *page;
+	enum fullness_group fg;
+
+	if (!zs_can_compact(class))
+		return 0;
+
+	/* Each zspage is tried once, even if it was put back on the list */
+	spin_lock(&class->lock);
+	nr_src = 0;
+	first_page = class->fullness_list[ZS_ALMOST_EMPTY];
+	if (first_page) {
+		nr_src = 1;
+		list_for_each_entry(page, &first_page->lru, lru)
+			nr_src++;
+	}
+	spin_unlock(&class->lock);
+
+	while (nr_src-- && pages_freed < nr_pages) {
+		spin_lock(&class->lock);
+		first_page = class->fullness_list[ZS_ALMOST_EMPTY];
+		if (!first_page || !zs_can_compact(class)) {
+			spin_unlock(&class->lock);
+			break;
+		}
+
+		/* The least recently inserted zspage is at the tail */
+		first_page = list_entry(first_page->lru.prev, struct page, lru);
+		remove_zspage(first_page, class, ZS_ALMOST_EMPTY);
+
+		ret = migrate_zspage(pool, class, first_page);
+
+		fg = get_fullness_group(first_page);
+		if (fg == ZS_EMPTY) {
+			class->pages_allocated -= class->zspage_order;
+			pages_freed += class->zspage_order;
+		} else {
+			insert_zspage(first_page, class, fg);
+			set_zspage_mapping(first_page, class->index, fg);
+		}
+		spin_unlock(&class->lock);
+
+		if (fg == ZS_EMPTY)
+			free_zspage(first_page);
+		if (ret == -ENOSPC)
+			break;
+
+		cond_resched();
+	}
+
+	return pages_freed;
+}
+
+/* Compacts @pool until @nr_pages pages were freed or nothing is left */
+static unsigned long __zs_compact(struct zs_pool *pool,
+				  unsigned long nr_pages)
+{
+	int i;
+	unsigned long pages_freed = 0;
+
+	if (!pool->ops)
+		return 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES && pages_freed < nr_pages; i++)
+		pages_freed += zs_compact_class(pool, &pool->size_class[i],
+						nr_pages - pages_freed);
+
+	atomic_long_add(pages_freed, &pool->pages_compacted);
+
+	return pages_freed;
+}
+
+/*
+ * shrink_slab() calls in batches of nr_to_scan pages, so only compact that
+ * much each time rather than the whole pool.
+ */
+static int zs_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	int i;
+	unsigned long nr = 0;
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+						shrinker);
+
+	if (sc->nr_to_scan)
+		__zs_compact(pool, sc->nr_to_scan);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		nr += zs_can_compact(class) * class->zspage_order;
+	}
+
+	return min_t(unsigned long, nr, INT_MAX);
+}
 
 /*
  * If this becomes a separate module, register zs_init() with
@@ -488,7 +773,18 @@ fail:
 	return notifier_to_errno(ret);
 }
 
-struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
+/**
+ * zs_create_pool - Create a pool of objects
+ * @name: name of the pool
+ * @flags: allocation flags used to grow the pool
+ * @ops: callbacks used to move objects, or NULL
+ * @private: passed to @ops
+ *
+ * If @ops is given, zs_compact() can be used on the pool, and is also
+ * run by a shrinker when memory is low.
+ */
+struct zs_pool *zs_create_pool(const char *name, gfp_t flags,
+			struct zs_ops *ops, void *private)
 {
 	int i, error, ovhd_size;
 	struct zs_pool *pool;
@@ -530,6 +826,14 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 
 	pool->flags = flags;
 	pool->name = name;
+	pool->ops = ops;
+	pool->private = private;
+
+	if (ops) {
+		pool->shrinker.shrink = zs_shrink;
+		pool->shrinker.seeks = DEFAULT_SEEKS;
+		register_shrinker(&pool->shrinker);
+	}
 
 	error = 0; /* Success */
 
@@ -547,6 +851,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	if (pool->ops)
+		unregister_shrinker(&pool->shrinker);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -579,12 +886,9 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
 void *zs_malloc(struct zs_pool *pool, size_t size)
 {
 	void *obj;
-	struct link_free *link;
 	int class_idx;
 	struct size_class *class;
-
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	struct page *first_page;
 
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return NULL;
@@ -607,17 +911,7 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 		class->pages_allocated += class->zspage_order;
 	}
 
-	obj = first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
-
-	first_page->inuse++;
+	obj = obj_malloc(first_page, class);
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
 	spin_unlock(&class->lock);
@@ -628,9 +922,8 @@ EXPORT_SYMBOL_GPL(zs_malloc);
 
 void zs_free(struct zs_pool *pool, void *obj)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
+	unsigned long f_objidx;
 
 	int class_idx;
 	struct size_class *class;
@@ -644,18 +937,9 @@ void zs_free(struct zs_pool *pool, void *obj)
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = obj;
-
-	first_page->inuse--;
+	obj_free(first_page, class, obj);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
@@ -668,15 +952,21 @@ void zs_free(struct zs_pool *pool, void *obj)
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
+/*
+ * Only one object can be mapped per CPU at a time: the mapping is
+ * recorded in the per-cpu zs_map_area so that zs_unmap_object() does
+ * not need to look up the object again.
+ */
 void *zs_map_object(struct zs_pool *pool, void *handle)
 {
-	struct page *page;
+	struct page *page, *nextp;
 	unsigned long obj_idx, off;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
 	struct size_class *class;
 	struct mapping_area *area;
+	void *addr;
 
 	BUG_ON(!handle);
 
@@ -685,24 +975,27 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
 
-	area = &get_cpu_var(zs_map_area);
 	if (off + class->size <= PAGE_SIZE) {
-		/* this object is contained entirely within a page */
-		area->vm_addr = kmap_atomic(page);
-	} else {
-		/* this object spans two pages */
-		struct page *nextp;
-
-		nextp = get_next_page(page);
-		BUG_ON(!nextp);
+		/*
+		 * This object is contained entirely within a page: the
+		 * mapping area is not needed, and kmap_atomic() already
+		 * disables preemption.
+		 */
+		addr = kmap_atomic(page);
+		__get_cpu_var(zs_map_area).vm_addr = addr;
+		return addr + off;
+	}
 
+	/* this object spans two pages */
+	nextp = get_next_page(page);
+	BUG_ON(!nextp);
 
-		set_pte(area->vm_ptes[0], mk_pte(page, PAGE_KERNEL));
-		set_pte(area->vm_ptes[1], mk_pte(nextp, PAGE_KERNEL));
+	area = &get_cpu_var(zs_map_area);
+	set_pte(area->vm_ptes[0], mk_pte(page, PAGE_KERNEL));
+	set_pte(area->vm_ptes[1], mk_pte(nextp, PAGE_KERNEL));
 
-		/* We pre-allocated VM area so mapping can never fail */
-		area->vm_addr = area->vm->addr;
-	}
+	/* We pre-allocated VM area so mapping can never fail */
+	area->vm_addr = area->vm->addr;
 
 	return area->vm_addr + off;
 }
@@ -710,30 +1003,21 @@ EXPORT_SYMBOL_GPL(zs_map_object);
 
 void zs_unmap_object(struct zs_pool *pool, void *handle)
 {
-	struct page *page;
-	unsigned long obj_idx, off;
-
-	unsigned int class_idx;
-	enum fullness_group fg;
-	struct size_class *class;
 	struct mapping_area *area;
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
-	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
-	class = &pool->size_class[class_idx];
-	off = obj_idx_to_offset(page, obj_idx, class->size);
-
 	area = &__get_cpu_var(zs_map_area);
-	if (off + class->size <= PAGE_SIZE) {
+	if (area->vm_addr != area->vm->addr) {
+		/* single page object, mapped with kmap_atomic() */
 		kunmap_atomic(area->vm_addr);
-	} else {
-		set_pte(area->vm_ptes[0], __pte(0));
-		set_pte(area->vm_ptes[1], __pte(0));
-		__flush_tlb_one((unsigned long)area->vm_addr);
-		__flush_tlb_one((unsigned long)area->vm_addr + PAGE_SIZE);
+		return;
 	}
+
+	set_pte(area->vm_ptes[0], __pte(0));
+	set_pte(area->vm_ptes[1], __pte(0));
+	__flush_tlb_one((unsigned long)area->vm_addr);
+	__flush_tlb_one((unsigned long)area->vm_addr + PAGE_SIZE);
 	put_cpu_var(zs_map_area);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
@@ -749,3 +1033,26 @@ u64 zs_get_total_size_bytes(struct zs_pool *pool)
 	return npages << PAGE_SHIFT;
 }
 EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
+
+/**
+ * zs_compact - Free zspages by moving their objects to other zspages
+ * @pool: pool to compact
+ *
+ * Sparsely used zspages are emptied into other zspages of their size
+ * class, as long as the owner of each object agrees to it (see struct
+ * zs_ops). Does nothing on pools created without zs_ops.
+ *
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	return __zs_compact(pool, ULONG_MAX);
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+/* Total number of pages freed by compaction */
+u64 zs_get_pages_compacted(struct zs_pool *pool)
+{
+	return atomic_long_read(&pool->pages_compacted);
+}
+EXPORT_SYMBOL_GPL(zs_get_pages_compacted);
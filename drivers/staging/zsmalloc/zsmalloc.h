@@ -17,7 +17,26 @@
 
 struct zs_pool;
 
-struct zs_pool *zs_create_pool(const char *name, gfp_t flags);
+/*
+ * Lets zs_compact() move allocated objects, changing their handles.
+ * Callbacks get the private pointer passed to zs_create_pool(). Objects
+ * are moved by compaction only if the pool has these.
+ */
+struct zs_ops {
+	/*
+	 * Find the owner of the object at @handle, e.g. through a
+	 * back-reference stored in it, and keep it from accessing the
+	 * object until migrate() is called. Return false to leave the
+	 * object in place. Called with internal locks held: must not
+	 * sleep nor wait for anything that may call into zsmalloc.
+	 */
+	bool (*isolate)(void *private, void *handle);
+	/* Make the owner use @new, a copy of @old, and release it */
+	void (*migrate)(void *private, void *old, void *new);
+};
+
+struct zs_pool *zs_create_pool(const char *name, gfp_t flags,
+			struct zs_ops *ops, void *private);
 void zs_destroy_pool(struct zs_pool *pool);
 
 void *zs_malloc(struct zs_pool *pool, size_t size);
@@ -28,4 +47,7 @@ void zs_unmap_object(struct zs_pool *pool, void *handle);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
 
+unsigned long zs_compact(struct zs_pool *pool);
+u64 zs_get_pages_compacted(struct zs_pool *pool);
+
 #endif
@@ -14,6 +14,7 @@
 #define _ZS_MALLOC_INT_H_
 
 #include <linux/kernel.h>
+#include <linux/shrinker.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
 
@@ -81,6 +82,14 @@
 #define ZS_SIZE_CLASSES		((ZS_MAX_ALLOC_SIZE - ZS_MIN_ALLOC_SIZE) / \
 					ZS_SIZE_CLASS_DELTA + 1)
 
+/*
+ * Upper bound on the number of objects starting in a zspage: each of its
+ * pages may also hold the start of an object continued on the next one.
+ */
+#define ZS_MAX_OBJS_PER_ZSPAGE	\
+	((ZS_MAX_PAGES_PER_ZSPAGE << PAGE_SHIFT) / ZS_MIN_ALLOC_SIZE + \
+		ZS_MAX_PAGES_PER_ZSPAGE)
+
 /*
  * We do not maintain any list for completely empty or full pages
  */
@@ -130,6 +139,7 @@ struct size_class {
 
 	/* stats */
 	u64 pages_allocated;
+	unsigned long objs_inuse;
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -150,6 +160,12 @@ struct zs_pool {
 
 	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
+
+	/* compaction, see zs_compact() */
+	struct zs_ops *ops;
+	void *private;
+	struct shrinker shrinker;
+	atomic_long_t pages_compacted;
 };
 
 #endif
@@ -79,6 +79,7 @@ struct sched_param {
 #include <linux/seccomp.h>
 #include <linux/rcupdate.h>
 #include <linux/rculist.h>
+#include <linux/list_nulls.h>
 #include <linux/rtmutex.h>
 
 #include <linux/time.h>
@@ -142,6 +143,15 @@ extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+/*
+ * Decayed load tracking, see __update_entity_runnable_avg(). Values are
+ * scaled by 1 << SCHED_UTIL_SHIFT and weight the last ~32ms the most.
+ */
+#define SCHED_UTIL_SHIFT	10
+extern unsigned int sched_get_cpu_util(int cpu);
+extern unsigned int sched_get_nr_running_avg(int cpu);
+extern unsigned int sched_get_task_util(struct task_struct *p);
+
 
 extern void calc_global_load(unsigned long ticks);
 
@@ -1172,6 +1182,17 @@ struct load_weight {
 	unsigned long weight, inv_weight;
 };
 
+struct sched_avg {
+	/*
+	 * These sums represent an infinite geometric series and so are bound
+	 * above by 1024/(1-y). Thus we only need a u32 to store them for all
+	 * choices of y < 1-2^(-32)*1024.
+	 */
+	u32 runnable_avg_sum, runnable_avg_period;
+	u64 last_runnable_update;
+	unsigned long load_avg_contrib;
+};
+
 #ifdef CONFIG_SCHEDSTATS
 struct sched_statistics {
 	u64			wait_start;
@@ -1205,6 +1226,9 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+
+	/* rq->clock at the last wakeup, until the task gets to run */
+	u64			wakeup_start;
 };
 #endif
 
@@ -1221,6 +1245,9 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+	/* Per-entity load tracking */
+	struct sched_avg	avg;
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1328,6 +1355,11 @@ struct task_struct {
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	/* lowmemorykiller index of processes, keyed by lowmem_score_adj */
+	struct hlist_nulls_node lowmem_node;
+	int lowmem_score_adj;
+#endif
 
 	struct mm_struct *mm, *active_mm;
 #ifdef CONFIG_COMPAT_BRK
@@ -441,4 +441,38 @@ static inline void page_key_write(void *address) {}
 
 #endif /* !CONFIG_ARCH_SAVE_PAGE_KEYS */
 
+/* Phases of a suspend cycle timed by CONFIG_SUSPEND_TIME */
+enum suspend_time_phase {
+	SUSPEND_TIME_SYNC,
+	SUSPEND_TIME_FREEZE,
+	SUSPEND_TIME_DPM_SUSPEND,
+	SUSPEND_TIME_DPM_SUSPEND_END,
+	SUSPEND_TIME_SYSCORE_SUSPEND,
+	SUSPEND_TIME_SYSCORE_RESUME,
+	SUSPEND_TIME_DPM_RESUME_START,
+	SUSPEND_TIME_DPM_RESUME,
+	SUSPEND_TIME_THAW,
+	SUSPEND_TIME_NR_PHASES,
+};
+
+#ifdef CONFIG_SUSPEND_TIME
+extern void suspend_time_cycle_begin(void);
+extern void suspend_time_cycle_end(int error);
+extern u64 suspend_time_phase_begin(enum suspend_time_phase phase);
+extern void suspend_time_phase_end(enum suspend_time_phase phase, u64 start);
+extern u64 suspend_time_device_begin(void);
+extern void suspend_time_device_end(struct device *dev, u64 start);
+#else /* !CONFIG_SUSPEND_TIME */
+static inline void suspend_time_cycle_begin(void) {}
+static inline void suspend_time_cycle_end(int error) {}
+static inline u64 suspend_time_phase_begin(enum suspend_time_phase phase)
+{
+	return 0;
+}
+static inline void suspend_time_phase_end(enum suspend_time_phase phase,
+					  u64 start) {}
+static inline u64 suspend_time_device_begin(void) { return 0; }
+static inline void suspend_time_device_end(struct device *dev, u64 start) {}
+#endif /* !CONFIG_SUSPEND_TIME */
+
 #endif /* _LINUX_SUSPEND_H */
@@ -0,0 +1,38 @@
+#ifndef __LINUX_VMPRESSURE_H
+#define __LINUX_VMPRESSURE_H
+
+#include <linux/gfp.h>
+#include <linux/notifier.h>
+
+/*
+ * Memory pressure is the percentage of scanned pages that reclaim failed
+ * to free, computed over windows of scanned pages. Listeners registered
+ * with vmpressure_register_notifier() are called from process context
+ * after each window with the pressure as action.
+ */
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+#ifdef CONFIG_VMPRESSURE
+extern void vmpressure(gfp_t gfp, unsigned long scanned,
+		       unsigned long reclaimed);
+extern void vmpressure_prio(gfp_t gfp, int prio);
+extern enum vmpressure_levels vmpressure_level(unsigned long pressure);
+extern int vmpressure_register_notifier(struct notifier_block *nb);
+extern int vmpressure_unregister_notifier(struct notifier_block *nb);
+#else
+static inline void vmpressure(gfp_t gfp, unsigned long scanned,
+			      unsigned long reclaimed)
+{
+}
+
+static inline void vmpressure_prio(gfp_t gfp, int prio)
+{
+}
+#endif
+
+#endif /* __LINUX_VMPRESSURE_H */
@@ -0,0 +1,91 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(binder_send,
+	    TP_PROTO(int debug_id, int reply_to, int to_proc, int to_thread,
+		     unsigned int code, unsigned int flags),
+
+	    TP_ARGS(debug_id, reply_to, to_proc, to_thread, code, flags),
+
+	    TP_STRUCT__entry(
+		    __field(int, debug_id)
+		    __field(int, reply_to)
+		    __field(int, to_proc)
+		    __field(int, to_thread)
+		    __field(unsigned int, code)
+		    __field(unsigned int, flags)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->debug_id = debug_id;
+		    __entry->reply_to = reply_to;
+		    __entry->to_proc = to_proc;
+		    __entry->to_thread = to_thread;
+		    __entry->code = code;
+		    __entry->flags = flags;
+		    ),
+
+	    TP_printk("transaction=%d reply_to=%d dest_proc=%d dest_thread=%d "
+		      "code=0x%x flags=0x%x",
+		      __entry->debug_id, __entry->reply_to, __entry->to_proc,
+		      __entry->to_thread, __entry->code, __entry->flags)
+);
+
+/* A transaction was queued to its target */
+DEFINE_EVENT(binder_send, binder_transaction,
+	    TP_PROTO(int debug_id, int reply_to, int to_proc, int to_thread,
+		     unsigned int code, unsigned int flags),
+
+	    TP_ARGS(debug_id, reply_to, to_proc, to_thread, code, flags)
+);
+
+/* A reply to transaction reply_to was queued to the caller */
+DEFINE_EVENT(binder_send, binder_reply,
+	    TP_PROTO(int debug_id, int reply_to, int to_proc, int to_thread,
+		     unsigned int code, unsigned int flags),
+
+	    TP_ARGS(debug_id, reply_to, to_proc, to_thread, code, flags)
+);
+
+DECLARE_EVENT_CLASS(binder_receive,
+	    TP_PROTO(int debug_id, s64 latency_ns),
+
+	    TP_ARGS(debug_id, latency_ns),
+
+	    TP_STRUCT__entry(
+		    __field(int, debug_id)
+		    __field(s64, latency_ns)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->debug_id = debug_id;
+		    __entry->latency_ns = latency_ns;
+		    ),
+
+	    TP_printk("transaction=%d latency_ns=%lld",
+		      __entry->debug_id, __entry->latency_ns)
+);
+
+/* A thread of the target picked up a transaction, latency_ns after send */
+DEFINE_EVENT(binder_receive, binder_transaction_received,
+	    TP_PROTO(int debug_id, s64 latency_ns),
+
+	    TP_ARGS(debug_id, latency_ns)
+);
+
+/* The caller picked up a reply, latency_ns after it was sent */
+DEFINE_EVENT(binder_receive, binder_reply_received,
+	    TP_PROTO(int debug_id, s64 latency_ns),
+
+	    TP_ARGS(debug_id, latency_ns)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -1461,6 +1461,7 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 		attach_pid(p, PIDTYPE_PID, pid);
 		nr_threads++;
 	}
+	lowmem_task_add(p);
 
 	total_forks++;
 	spin_unlock(&current->sighand->siglock);
@@ -13,10 +13,13 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -30,6 +33,13 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Run the handlers of one level concurrently on early_suspend_wq */
+static bool parallel = true;
+module_param(parallel, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static struct workqueue_struct *early_suspend_wq;
+static s64 early_suspend_us, late_resume_us;
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -49,6 +59,8 @@ void register_early_suspend(struct early_suspend *handler)
 	struct list_head *pos;
 
 	mutex_lock(&early_suspend_lock);
+	handler->suspend_us = handler->suspend_max_us = 0;
+	handler->resume_us = handler->resume_max_us = 0;
 	list_for_each(pos, &early_suspend_handlers) {
 		struct early_suspend *e;
 		e = list_entry(pos, struct early_suspend, link);
@@ -70,9 +82,95 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static struct early_suspend *next_handler(struct early_suspend *h,
+					  bool resume)
+{
+	return list_entry(resume ? h->link.prev : h->link.next,
+			  struct early_suspend, link);
+}
+
+static bool has_callback(struct early_suspend *h, bool resume)
+{
+	return resume ? h->resume != NULL : h->suspend != NULL;
+}
+
+static void call_handler(struct early_suspend *h, bool resume)
+{
+	ktime_t start = ktime_get();
+	s64 us;
+
+	if (resume) {
+		if (debug_mask & DEBUG_VERBOSE)
+			pr_info("late_resume: calling %pf\n", h->resume);
+		h->resume(h);
+		us = ktime_us_delta(ktime_get(), start);
+		h->resume_us = us;
+		h->resume_max_us = max(h->resume_max_us, us);
+	} else {
+		if (debug_mask & DEBUG_VERBOSE)
+			pr_info("early_suspend: calling %pf\n", h->suspend);
+		h->suspend(h);
+		us = ktime_us_delta(ktime_get(), start);
+		h->suspend_us = us;
+		h->suspend_max_us = max(h->suspend_max_us, us);
+	}
+}
+
+static void call_suspend_work(struct work_struct *work)
+{
+	call_handler(container_of(work, struct early_suspend, work), false);
+}
+
+static void call_resume_work(struct work_struct *work)
+{
+	call_handler(container_of(work, struct early_suspend, work), true);
+}
+
+/*
+ * Call the handlers of the level of @first and return the first handler
+ * of the next level. When running in parallel, all handlers of the level
+ * but the last are queued on early_suspend_wq, the last one is called
+ * directly and the others are waited for before moving to the next
+ * level. Called with early_suspend_lock held.
+ */
+static struct early_suspend *call_level(struct early_suspend *first,
+					bool resume)
+{
+	struct early_suspend *pos, *end, *last = NULL;
+	bool queue = parallel && early_suspend_wq;
+
+	for (end = first; &end->link != &early_suspend_handlers &&
+	     end->level == first->level; end = next_handler(end, resume))
+		if (has_callback(end, resume))
+			last = end;
+	if (!last)
+		return end;
+
+	for (pos = first; pos != last; pos = next_handler(pos, resume)) {
+		if (!has_callback(pos, resume))
+			continue;
+		if (queue) {
+			INIT_WORK(&pos->work, resume ? call_resume_work :
+						       call_suspend_work);
+			queue_work(early_suspend_wq, &pos->work);
+		} else {
+			call_handler(pos, resume);
+		}
+	}
+	call_handler(last, resume);
+
+	if (queue)
+		for (pos = first; pos != last; pos = next_handler(pos, resume))
+			if (has_callback(pos, resume))
+				flush_work(&pos->work);
+
+	return end;
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
+	ktime_t start;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -93,13 +191,12 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
-		}
-	}
+	start = ktime_get();
+	pos = list_first_entry(&early_suspend_handlers, struct early_suspend,
+			       link);
+	while (&pos->link != &early_suspend_handlers)
+		pos = call_level(pos, false);
+	early_suspend_us = ktime_us_delta(ktime_get(), start);
 	mutex_unlock(&early_suspend_lock);
 
 	suspend_sys_sync_queue();
@@ -113,6 +210,7 @@ abort:
 static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
+	ktime_t start;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -131,14 +229,12 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
-	}
+	start = ktime_get();
+	pos = list_entry(early_suspend_handlers.prev, struct early_suspend,
+			 link);
+	while (&pos->link != &early_suspend_handlers)
+		pos = call_level(pos, true);
+	late_resume_us = ktime_us_delta(ktime_get(), start);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -181,3 +277,54 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+static int __init early_suspend_init(void)
+{
+	early_suspend_wq = alloc_workqueue("early_suspend",
+					   WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!early_suspend_wq)
+		pr_err("early_suspend: failed to create workqueue, "
+		       "handlers will run serially\n");
+	return 0;
+}
+core_initcall(early_suspend_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_debug_show(struct seq_file *s, void *data)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(s, "early_suspend %lld us, late_resume %lld us\n",
+		   early_suspend_us, late_resume_us);
+	seq_printf(s, "level  suspend_us    max_us  resume_us    max_us  "
+		   "handler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d %11lld %9lld %10lld %9lld  %pf/%pf\n",
+			   pos->level, pos->suspend_us, pos->suspend_max_us,
+			   pos->resume_us, pos->resume_max_us,
+			   pos->suspend, pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_debug_show, NULL);
+}
+
+static const struct file_operations early_suspend_debug_fops = {
+	.open		= early_suspend_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	debugfs_create_file("early_suspend", S_IRUGO, NULL, NULL,
+			    &early_suspend_debug_fops);
+	return 0;
+}
+late_initcall(early_suspend_debug_init);
+#endif
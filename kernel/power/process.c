@@ -144,6 +144,7 @@ static int try_to_freeze_tasks(bool user_only)
 int freeze_processes(void)
 {
 	int error;
+	u64 start;
 
 	error = __usermodehelper_disable(UMH_FREEZING);
 	if (error)
@@ -154,7 +155,9 @@ int freeze_processes(void)
 
 	printk("Freezing user space processes ... ");
 	pm_freezing = true;
+	start = suspend_time_phase_begin(SUSPEND_TIME_FREEZE);
 	error = try_to_freeze_tasks(true);
+	suspend_time_phase_end(SUSPEND_TIME_FREEZE, start);
 	if (!error) {
 		printk("done.");
 		__usermodehelper_set_disable_depth(UMH_DISABLED);
@@ -179,6 +182,7 @@ int freeze_processes(void)
 int freeze_kernel_threads(void)
 {
 	int error;
+	u64 start;
 
 	error = suspend_sys_sync_wait();
 	if (error)
@@ -186,7 +190,9 @@ int freeze_kernel_threads(void)
 
 	printk("Freezing remaining freezable tasks ... ");
 	pm_nosig_freezing = true;
+	start = suspend_time_phase_begin(SUSPEND_TIME_FREEZE);
 	error = try_to_freeze_tasks(false);
+	suspend_time_phase_end(SUSPEND_TIME_FREEZE, start);
 	if (!error)
 		printk("done.");
 
@@ -201,6 +207,7 @@ int freeze_kernel_threads(void)
 void thaw_processes(void)
 {
 	struct task_struct *g, *p;
+	u64 start = suspend_time_phase_begin(SUSPEND_TIME_THAW);
 
 	if (pm_freezing)
 		atomic_dec(&system_freezing_cnt);
@@ -223,6 +230,7 @@ void thaw_processes(void)
 
 	schedule();
 	printk("done.\n");
+	suspend_time_phase_end(SUSPEND_TIME_THAW, start);
 }
 
 void thaw_kernel_threads(void)
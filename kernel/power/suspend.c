@@ -139,6 +139,7 @@ void __attribute__ ((weak)) arch_suspend_enable_irqs(void)
 static int suspend_enter(suspend_state_t state, bool *wakeup)
 {
 	int error;
+	u64 start;
 
 	if (suspend_ops->prepare) {
 		error = suspend_ops->prepare();
@@ -146,7 +147,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 			goto Platform_finish;
 	}
 
+	start = suspend_time_phase_begin(SUSPEND_TIME_DPM_SUSPEND_END);
 	error = dpm_suspend_end(PMSG_SUSPEND);
+	suspend_time_phase_end(SUSPEND_TIME_DPM_SUSPEND_END, start);
 	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to power down\n");
 		goto Platform_finish;
@@ -168,14 +171,18 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 	arch_suspend_disable_irqs();
 	BUG_ON(!irqs_disabled());
 
+	start = suspend_time_phase_begin(SUSPEND_TIME_SYSCORE_SUSPEND);
 	error = syscore_suspend();
+	suspend_time_phase_end(SUSPEND_TIME_SYSCORE_SUSPEND, start);
 	if (!error) {
 		*wakeup = pm_wakeup_pending();
 		if (!(suspend_test(TEST_CORE) || *wakeup)) {
 			error = suspend_ops->enter(state);
 			events_check_enabled = false;
 		}
+		start = suspend_time_phase_begin(SUSPEND_TIME_SYSCORE_RESUME);
 		syscore_resume();
+		suspend_time_phase_end(SUSPEND_TIME_SYSCORE_RESUME, start);
 	}
 
 	arch_suspend_enable_irqs();
@@ -188,7 +195,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 	if (suspend_ops->wake)
 		suspend_ops->wake();
 
+	start = suspend_time_phase_begin(SUSPEND_TIME_DPM_RESUME_START);
 	dpm_resume_start(PMSG_RESUME);
+	suspend_time_phase_end(SUSPEND_TIME_DPM_RESUME_START, start);
 
  Platform_finish:
 	if (suspend_ops->finish)
@@ -205,6 +214,7 @@ int suspend_devices_and_enter(suspend_state_t state)
 {
 	int error;
 	bool wakeup = false;
+	u64 start;
 
 	if (!suspend_ops)
 		return -ENOSYS;
@@ -217,7 +227,9 @@ int suspend_devices_and_enter(suspend_state_t state)
 	}
 	suspend_console();
 	suspend_test_start();
+	start = suspend_time_phase_begin(SUSPEND_TIME_DPM_SUSPEND);
 	error = dpm_suspend_start(PMSG_SUSPEND);
+	suspend_time_phase_end(SUSPEND_TIME_DPM_SUSPEND, start);
 	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to suspend\n");
 		goto Recover_platform;
@@ -233,7 +245,9 @@ int suspend_devices_and_enter(suspend_state_t state)
 
  Resume_devices:
 	suspend_test_start();
+	start = suspend_time_phase_begin(SUSPEND_TIME_DPM_RESUME);
 	dpm_resume_end(PMSG_RESUME);
+	suspend_time_phase_end(SUSPEND_TIME_DPM_RESUME, start);
 	suspend_test_finish("resume devices");
 	resume_console();
  Close:
@@ -328,7 +342,9 @@ int pm_suspend(suspend_state_t state)
 		return -EINVAL;
 
 	pm_suspend_marker("entry");
+	suspend_time_cycle_begin();
 	error = enter_state(state);
+	suspend_time_cycle_end(error);
 	if (error) {
 		suspend_stats.fail++;
 		dpm_save_failed_errno(error);
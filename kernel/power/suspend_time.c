@@ -1,5 +1,6 @@
 /*
- * debugfs file to track time spent in suspend
+ * debugfs file to track time spent in suspend, and in each phase of
+ * suspend and resume
  *
  * Copyright (c) 2011, Google, Inc.
  *
@@ -15,16 +16,241 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/device.h>
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
 
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+#define SUSPEND_TIME_CYCLES		16
+#define SUSPEND_TIME_NAME_LEN		32
+#define SUSPEND_TIME_DEV_BINS		20
+#define SUSPEND_TIME_DEV_HASH_BITS	6
+
+/* dpm phases for which device callbacks are timed */
+enum {
+	DEV_PHASE_SUSPEND,
+	DEV_PHASE_SUSPEND_END,
+	DEV_PHASE_RESUME_START,
+	DEV_PHASE_RESUME,
+	DEV_PHASE_COUNT,
+};
+
+static const char * const phase_names[SUSPEND_TIME_NR_PHASES] = {
+	[SUSPEND_TIME_SYNC]		= "sync",
+	[SUSPEND_TIME_FREEZE]		= "freeze",
+	[SUSPEND_TIME_DPM_SUSPEND]	= "dpm_suspend",
+	[SUSPEND_TIME_DPM_SUSPEND_END]	= "dpm_suspend_end",
+	[SUSPEND_TIME_SYSCORE_SUSPEND]	= "syscore_suspend",
+	[SUSPEND_TIME_SYSCORE_RESUME]	= "syscore_resume",
+	[SUSPEND_TIME_DPM_RESUME_START]	= "dpm_resume_start",
+	[SUSPEND_TIME_DPM_RESUME]	= "dpm_resume",
+	[SUSPEND_TIME_THAW]		= "thaw",
+};
+
+static const char * const dev_phase_names[DEV_PHASE_COUNT] = {
+	[DEV_PHASE_SUSPEND]		= "suspend",
+	[DEV_PHASE_SUSPEND_END]		= "suspend_end",
+	[DEV_PHASE_RESUME_START]	= "resume_start",
+	[DEV_PHASE_RESUME]		= "resume",
+};
+
+struct suspend_time_cycle {
+	struct timespec ts;
+	u64 start;
+	u32 total_us;
+	u32 phase_us[SUSPEND_TIME_NR_PHASES];
+	u32 sleep_ms;
+	int error;
+	char slowest[SUSPEND_TIME_NAME_LEN];
+	u32 slowest_us;
+};
+
+/*
+ * Callback times of one device, bin i of a histogram counts the calls
+ * that took less than 2^i us.
+ */
+struct suspend_time_dev {
+	struct hlist_node node;
+	char name[SUSPEND_TIME_NAME_LEN];
+	u32 last_us[DEV_PHASE_COUNT];
+	u32 max_us[DEV_PHASE_COUNT];
+	u32 hist[DEV_PHASE_COUNT][SUSPEND_TIME_DEV_BINS];
+};
+
+/*
+ * Protects everything below. Phases can end with interrupts disabled and
+ * device callbacks can run in parallel from async threads.
+ */
+static DEFINE_SPINLOCK(suspend_time_lock);
+static struct hlist_head dev_hash[1 << SUSPEND_TIME_DEV_HASH_BITS];
+static struct suspend_time_cycle cycles[SUSPEND_TIME_CYCLES];
+static unsigned int cycle_next, nr_cycles;
+static struct suspend_time_cycle cur_cycle;
+static int cycle_depth;
+static int cur_dev_phase = -1;
+
+static u32 suspend_time_us(u64 start)
+{
+	return div_u64(local_clock() - start, NSEC_PER_USEC);
+}
+
+/*
+ * Start timing a suspend cycle. Cycles nest: one started by the wake lock
+ * suspend work covers the pm_suspend() call it makes.
+ */
+void suspend_time_cycle_begin(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	if (cycle_depth++ == 0) {
+		memset(&cur_cycle, 0, sizeof(cur_cycle));
+		getnstimeofday(&cur_cycle.ts);
+		cur_cycle.start = local_clock();
+	}
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+}
+
+void suspend_time_cycle_end(int error)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	if (!cycle_depth)
+		goto out;
+	if (error && !cur_cycle.error)
+		cur_cycle.error = error;
+	if (--cycle_depth)
+		goto out;
+
+	cur_cycle.total_us = suspend_time_us(cur_cycle.start);
+	cycles[cycle_next] = cur_cycle;
+	cycle_next = (cycle_next + 1) % SUSPEND_TIME_CYCLES;
+	if (nr_cycles < SUSPEND_TIME_CYCLES)
+		nr_cycles++;
+out:
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+}
+
+static int dev_phase(enum suspend_time_phase phase)
+{
+	switch (phase) {
+	case SUSPEND_TIME_DPM_SUSPEND:
+		return DEV_PHASE_SUSPEND;
+	case SUSPEND_TIME_DPM_SUSPEND_END:
+		return DEV_PHASE_SUSPEND_END;
+	case SUSPEND_TIME_DPM_RESUME_START:
+		return DEV_PHASE_RESUME_START;
+	case SUSPEND_TIME_DPM_RESUME:
+		return DEV_PHASE_RESUME;
+	default:
+		return -1;
+	}
+}
+
+/* Returns the start time to pass to suspend_time_phase_end() */
+u64 suspend_time_phase_begin(enum suspend_time_phase phase)
+{
+	if (dev_phase(phase) >= 0)
+		cur_dev_phase = dev_phase(phase);
+	return local_clock();
+}
+
+/*
+ * Add the time since @start to @phase of the current cycle. A phase can
+ * run several times in one cycle, e.g. when suspend_again() is used.
+ */
+void suspend_time_phase_end(enum suspend_time_phase phase, u64 start)
+{
+	unsigned long flags;
+	u32 us = suspend_time_us(start);
+
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	if (dev_phase(phase) >= 0)
+		cur_dev_phase = -1;
+	if (cycle_depth)
+		cur_cycle.phase_us[phase] += us;
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+}
+
+static struct suspend_time_dev *suspend_time_dev_find(const char *name,
+						      struct hlist_head *head)
+{
+	struct suspend_time_dev *sd;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(sd, pos, head, node)
+		if (!strcmp(sd->name, name))
+			return sd;
+	return NULL;
+}
+
+u64 suspend_time_device_begin(void)
+{
+	return local_clock();
+}
+
+/* Account a dpm callback of @dev that started at @start */
+void suspend_time_device_end(struct device *dev, u64 start)
+{
+	char name[SUSPEND_TIME_NAME_LEN];
+	struct suspend_time_dev *sd, *new = NULL;
+	struct hlist_head *head;
+	unsigned long flags;
+	u32 us = suspend_time_us(start);
+	int phase = ACCESS_ONCE(cur_dev_phase);
+
+	if (phase < 0 || !cycle_depth)
+		return;
+
+	strlcpy(name, dev_name(dev), sizeof(name));
+	head = &dev_hash[full_name_hash(name, strlen(name)) &
+			 ((1 << SUSPEND_TIME_DEV_HASH_BITS) - 1)];
+
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	sd = suspend_time_dev_find(name, head);
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+	if (!sd) {
+		/* May run from noirq callbacks, don't sleep */
+		new = kzalloc(sizeof(*new), GFP_NOWAIT | __GFP_NOWARN);
+		if (!new)
+			return;
+		strlcpy(new->name, name, sizeof(new->name));
+	}
+
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	if (!sd) {
+		sd = suspend_time_dev_find(name, head);
+		if (!sd) {
+			hlist_add_head(&new->node, head);
+			sd = new;
+			new = NULL;
+		}
+	}
+	sd->last_us[phase] = us;
+	sd->max_us[phase] = max(sd->max_us[phase], us);
+	sd->hist[phase][min(fls(us), SUSPEND_TIME_DEV_BINS - 1)]++;
+	if (us > cur_cycle.slowest_us) {
+		cur_cycle.slowest_us = us;
+		strlcpy(cur_cycle.slowest, name, sizeof(cur_cycle.slowest));
+	}
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+
+	kfree(new);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -53,6 +279,91 @@ static const struct file_operations suspend_time_debug_fops = {
 	.release	= single_release,
 };
 
+/* The last SUSPEND_TIME_CYCLES cycles, oldest first */
+static int suspend_phases_debug_show(struct seq_file *s, void *data)
+{
+	struct suspend_time_cycle *c;
+	unsigned long flags;
+	unsigned int i;
+	int phase;
+
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	for (i = 0; i < nr_cycles; i++) {
+		c = &cycles[(cycle_next + SUSPEND_TIME_CYCLES - nr_cycles + i) %
+			    SUSPEND_TIME_CYCLES];
+		seq_printf(s, "%lu.%03lu: error %d, total %u us, "
+			   "slept %u ms\n", c->ts.tv_sec,
+			   c->ts.tv_nsec / NSEC_PER_MSEC, c->error,
+			   c->total_us, c->sleep_ms);
+		for (phase = 0; phase < SUSPEND_TIME_NR_PHASES; phase++)
+			if (c->phase_us[phase])
+				seq_printf(s, "  %-18s %10u us\n",
+					   phase_names[phase],
+					   c->phase_us[phase]);
+		if (c->slowest_us)
+			seq_printf(s, "  slowest device %s, %u us\n",
+				   c->slowest, c->slowest_us);
+	}
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+	return 0;
+}
+
+static int suspend_phases_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_phases_debug_show, NULL);
+}
+
+static const struct file_operations suspend_phases_debug_fops = {
+	.open		= suspend_phases_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int suspend_devices_debug_show(struct seq_file *s, void *data)
+{
+	struct suspend_time_dev *sd;
+	struct hlist_node *pos;
+	unsigned long flags;
+	int i, phase, bin;
+
+	seq_printf(s, "device phase last_us max_us <2^n_us:count...\n");
+	spin_lock_irqsave(&suspend_time_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(dev_hash); i++) {
+		hlist_for_each_entry(sd, pos, &dev_hash[i], node) {
+			for (phase = 0; phase < DEV_PHASE_COUNT; phase++) {
+				if (!sd->max_us[phase] &&
+				    !sd->hist[phase][0])
+					continue;
+				seq_printf(s, "%s %s %u %u", sd->name,
+					   dev_phase_names[phase],
+					   sd->last_us[phase],
+					   sd->max_us[phase]);
+				for (bin = 0; bin < SUSPEND_TIME_DEV_BINS;
+				     bin++)
+					if (sd->hist[phase][bin])
+						seq_printf(s, " %d:%u", bin,
+							sd->hist[phase][bin]);
+				seq_putc(s, '\n');
+			}
+		}
+	}
+	spin_unlock_irqrestore(&suspend_time_lock, flags);
+	return 0;
+}
+
+static int suspend_devices_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_devices_debug_show, NULL);
+}
+
+static const struct file_operations suspend_devices_debug_fops = {
+	.open		= suspend_devices_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init suspend_time_debug_init(void)
 {
 	struct dentry *d;
@@ -64,6 +375,11 @@ static int __init suspend_time_debug_init(void)
 		return -ENOMEM;
 	}
 
+	debugfs_create_file("suspend_phases", S_IRUGO, NULL, NULL,
+			    &suspend_phases_debug_fops);
+	debugfs_create_file("suspend_devices", S_IRUGO, NULL, NULL,
+			    &suspend_devices_debug_fops);
+
 	return 0;
 }
 
@@ -87,6 +403,12 @@ static void suspend_time_syscore_resume(void)
 
 	time_in_suspend_bins[fls(after.tv_sec)]++;
 
+	spin_lock(&suspend_time_lock);
+	if (cycle_depth)
+		cur_cycle.sleep_ms += after.tv_sec * MSEC_PER_SEC +
+				      after.tv_nsec / NSEC_PER_MSEC;
+	spin_unlock(&suspend_time_lock);
+
 	pr_info("Suspended for %lu.%03lu seconds\n", after.tv_sec,
 		after.tv_nsec / NSEC_PER_MSEC);
 }
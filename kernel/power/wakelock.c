@@ -43,6 +43,16 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/*
+ * Active locks without a timeout are only counted. Those with a timeout
+ * are also kept in a tree sorted by expiry time, with its first and last
+ * entries cached, so that has_wake_lock_locked() doesn't need to walk
+ * the active list.
+ */
+static int nonexpiring_count[WAKE_LOCK_TYPE_COUNT];
+static struct rb_root expire_tree[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *expire_first[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *expire_last[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -61,7 +71,6 @@ static unsigned suspend_short_count;
 
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
@@ -110,7 +119,8 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		total_time = ktime_add(total_time, add_time);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
 			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+				ktime_sub(now,
+					  lock->stat.prevent_suspend_start));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
@@ -164,43 +174,108 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 		lock->stat.max_time = duration;
 	lock->stat.last_time = ktime_get();
 	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
+		duration = ktime_sub(now, lock->stat.prevent_suspend_start);
 		lock->stat.prevent_suspend_time = ktime_add(
 			lock->stat.prevent_suspend_time, duration);
 		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
 	}
 }
 
+/*
+ * Called when the main wake lock is taken (done) or released, to stop or
+ * start accounting the time every active lock prevents suspend.
+ */
 static void update_sleep_wait_stats_locked(int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
+	ktime_t now, etime, add;
 	int expired;
 
 	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
 	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
 		expired = get_expired_time(lock, &etime);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
+			add = ktime_sub(expired ? etime : now,
+					lock->stat.prevent_suspend_start);
 			lock->stat.prevent_suspend_time = ktime_add(
 				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
 			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
+		}
+		if (!done && !expired) {
 			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+			lock->stat.prevent_suspend_start = now;
+		}
 	}
-	last_sleep_time_update = now;
+}
+
+/* A lock taken while the main lock is not held starts preventing suspend */
+static void start_sleep_wait_stats_locked(struct wake_lock *lock)
+{
+	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
+		return;
+	lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+	lock->stat.prevent_suspend_start = ktime_get();
 }
 #endif
 
+static void expire_tree_add(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &expire_tree[type].rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *entry;
+	bool leftmost = true, rightmost = true;
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct wake_lock, expire_node);
+		if ((long)(lock->expires - entry->expires) < 0) {
+			p = &parent->rb_left;
+			rightmost = false;
+		} else {
+			p = &parent->rb_right;
+			leftmost = false;
+		}
+	}
+	rb_link_node(&lock->expire_node, parent, p);
+	rb_insert_color(&lock->expire_node, &expire_tree[type]);
+
+	if (leftmost)
+		expire_first[type] = lock;
+	if (rightmost)
+		expire_last[type] = lock;
+}
+
+static void expire_tree_del(struct wake_lock *lock, int type)
+{
+	struct rb_node *node;
+
+	if (expire_first[type] == lock) {
+		node = rb_next(&lock->expire_node);
+		expire_first[type] = node ?
+			rb_entry(node, struct wake_lock, expire_node) : NULL;
+	}
+	if (expire_last[type] == lock) {
+		node = rb_prev(&lock->expire_node);
+		expire_last[type] = node ?
+			rb_entry(node, struct wake_lock, expire_node) : NULL;
+	}
+	rb_erase(&lock->expire_node, &expire_tree[type]);
+	RB_CLEAR_NODE(&lock->expire_node);
+}
+
+/* Drops an active lock from the counter or expiry tree it is accounted in */
+static void wake_lock_dequeue(struct wake_lock *lock, int type)
+{
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		expire_tree_del(lock, type);
+	else if (lock->flags & WAKE_LOCK_ACTIVE)
+		nonexpiring_count[type]--;
+}
+
 
 static void expire_wake_lock(struct wake_lock *lock)
 {
+	wake_lock_dequeue(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
@@ -234,23 +309,33 @@ static void print_active_locks(int type)
 	}
 }
 
+static void expire_wake_locks(unsigned long data);
+static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
+
+/*
+ * Expires the locks whose timeout passed, then returns -1 if a lock
+ * without timeout is active, or the number of jiffies until the last
+ * lock expires.
+ */
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
-	}
-	return max_timeout;
+	while ((lock = expire_first[type]) &&
+	       (long)(lock->expires - jiffies) <= 0)
+		expire_wake_lock(lock);
+
+	if (nonexpiring_count[type])
+		return -1;
+	lock = expire_last[type];
+	return lock ? lock->expires - jiffies : 0;
+}
+
+/* Arms the expire timer for the next lock to expire */
+static void expire_timer_start_locked(int type)
+{
+	mod_timer(&expire_timer, expire_first[type]->expires);
 }
 
 long has_wake_lock(int type)
@@ -267,10 +352,14 @@ long has_wake_lock(int type)
 
 static void suspend_sys_sync(struct work_struct *work)
 {
+	u64 start;
+
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("PM: Syncing filesystems...\n");
 
+	start = suspend_time_phase_begin(SUSPEND_TIME_SYNC);
 	sys_sync();
+	suspend_time_phase_end(SUSPEND_TIME_SYNC, start);
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("sync done.\n");
@@ -349,12 +438,14 @@ static void suspend(struct work_struct *work)
 	}
 
 	entry_event_num = current_event_num;
+	suspend_time_cycle_begin();
 	suspend_sys_sync_queue();
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
 	getnstimeofday(&ts_entry);
 	ret = pm_suspend(requested_suspend_state);
 	getnstimeofday(&ts_exit);
+	suspend_time_cycle_end(ret);
 
 	if (debug_mask & DEBUG_EXIT_SUSPEND) {
 		struct rtc_time tm;
@@ -396,11 +487,12 @@ static void expire_wake_locks(unsigned long data)
 	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
-	if (has_lock == 0)
+	if (has_lock > 0)
+		expire_timer_start_locked(WAKE_LOCK_SUSPEND);
+	else if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
-static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
@@ -441,12 +533,14 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.wakeup_count = 0;
 	lock->stat.total_time = ktime_set(0, 0);
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
+	lock->stat.prevent_suspend_start = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	RB_CLEAR_NODE(&lock->expire_node);
 	spin_lock_irqsave(&list_lock, irqflags);
 	list_add(&lock->link, &inactive_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
@@ -459,7 +553,9 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	wake_lock_dequeue(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
@@ -504,6 +600,7 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 	}
 #endif
+	wake_lock_dequeue(lock, type);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
@@ -519,12 +616,14 @@ static void wake_lock_internal(
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
 		list_add_tail(&lock->link, &active_wake_locks[type]);
+		expire_tree_add(lock, type);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
 		list_add(&lock->link, &active_wake_locks[type]);
+		nonexpiring_count[type]++;
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
@@ -532,7 +631,7 @@ static void wake_lock_internal(
 		if (lock == &main_wake_lock)
 			update_sleep_wait_stats_locked(1);
 		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+			start_sleep_wait_stats_locked(lock);
 #endif
 		if (has_timeout)
 			expire_in = has_wake_lock_locked(type);
@@ -542,7 +641,7 @@ static void wake_lock_internal(
 			if (debug_mask & DEBUG_EXPIRE)
 				pr_info("wake_lock: %s, start expire timer, "
 					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
+			expire_timer_start_locked(type);
 		} else {
 			if (del_timer(&expire_timer))
 				if (debug_mask & DEBUG_EXPIRE)
@@ -578,6 +677,7 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	wake_lock_dequeue(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -587,7 +687,7 @@ void wake_unlock(struct wake_lock *lock)
 			if (debug_mask & DEBUG_EXPIRE)
 				pr_info("wake_unlock: %s, start expire timer, "
 					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
+			expire_timer_start_locked(type);
 		} else {
 			if (del_timer(&expire_timer))
 				if (debug_mask & DEBUG_EXPIRE)
@@ -632,8 +732,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		expire_tree[i] = RB_ROOT;
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
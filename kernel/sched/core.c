@@ -1442,6 +1442,7 @@ ttwu_do_activate(struct rq *rq, struct task_struct *p, int wake_flags)
 #endif
 
 	ttwu_activate(rq, p, ENQUEUE_WAKEUP | ENQUEUE_WAKING);
+	schedstat_wakeup_start(rq, p);
 	ttwu_do_wakeup(rq, p, wake_flags);
 }
 
@@ -1715,6 +1716,7 @@ static void __sched_fork(struct task_struct *p)
 	p->se.nr_migrations		= 0;
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
 
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
@@ -3028,6 +3030,7 @@ void scheduler_tick(void)
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
+	update_rq_runnable_avg(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
 
@@ -6948,6 +6951,10 @@ void __init sched_init(void)
 #endif /* CONFIG_CPUMASK_OFFSTACK */
 	}
 
+#if defined(CONFIG_CGROUP_SCHED) && defined(CONFIG_SCHEDSTATS)
+	root_task_group.wakeup_lat = alloc_percpu(struct wakeup_lat_hist);
+#endif
+
 #ifdef CONFIG_SMP
 	init_defrootdomain();
 #endif
@@ -6979,6 +6986,7 @@ void __init sched_init(void)
 
 		rq = cpu_rq(i);
 		raw_spin_lock_init(&rq->lock);
+		seqcount_init(&rq->avg_seq);
 		rq->nr_running = 0;
 		rq->calc_load_active = 0;
 		rq->calc_load_update = jiffies + LOAD_FREQ;
@@ -7255,6 +7263,9 @@ static void free_sched_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+#ifdef CONFIG_SCHEDSTATS
+	free_percpu(tg->wakeup_lat);
+#endif
 	kfree(tg);
 }
 
@@ -7274,6 +7285,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHEDSTATS
+	tg->wakeup_lat = alloc_percpu(struct wakeup_lat_hist);
+	if (!tg->wakeup_lat)
+		goto err;
+#endif
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	list_add_rcu(&tg->list, &task_groups);
 
@@ -7995,6 +8012,29 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHEDSTATS
+/* Wakeup latencies of the group's tasks, summed over all cpus */
+static int cpu_wakeup_latency_show(struct cgroup *cgrp, struct cftype *cft,
+				   struct seq_file *seq)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct wakeup_lat_hist *hist, sum;
+	int cpu, class, bucket;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		hist = per_cpu_ptr(tg->wakeup_lat, cpu);
+		for (class = 0; class < WAKEUP_LAT_NR_CLASSES; class++)
+			for (bucket = 0; bucket < WAKEUP_LAT_BUCKETS; bucket++)
+				sum.count[class][bucket] +=
+					hist->count[class][bucket];
+	}
+	show_wakeup_lat(seq, "", &sum);
+
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -8031,6 +8071,12 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "wakeup_latency",
+		.read_seq_string = cpu_wakeup_latency_show,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
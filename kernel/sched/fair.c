@@ -26,6 +26,7 @@
 #include <linux/slab.h>
 #include <linux/profile.h>
 #include <linux/interrupt.h>
+#include <linux/export.h>
 
 #include <trace/events/sched.h>
 
@@ -1080,6 +1081,250 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 	se->vruntime = vruntime;
 }
 
+/*
+ * Per-entity load tracking
+ *
+ * Runnable time is accounted in periods of 1024us (~1ms). The
+ * contribution of a period decays geometrically with its age, y^32 = 0.5,
+ * so that a period 32ms ago counts half as much as the current one. The
+ * ratio runnable_avg_sum / runnable_avg_period is then the fraction of
+ * recent time the entity was runnable.
+ */
+#define LOAD_AVG_PERIOD 32
+#define LOAD_AVG_MAX 47742 /* maximum possible runnable_avg_period */
+#define LOAD_AVG_MAX_N 345 /* number of full periods to produce LOAD_AVG_MAX */
+
+/* Precomputed fixed inverse multiplies for multiplication by y^n */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+	0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+	0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+	0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+	0x9837f050, 0x94f4efa8, 0x91c3d373, 0x8ea4398a, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/*
+ * Precomputed \Sum y^k { 1<=k<=n }. These are floor(true_value) to
+ * prevent over-estimates when re-combining.
+ */
+static const u32 runnable_avg_yN_sum[] = {
+	    0, 1002, 1982, 2941, 3880, 4798, 5697, 6576, 7437, 8279, 9103,
+	 9909, 10698, 11470, 12226, 12966, 13690, 14398, 15091, 15769, 16433,
+	17082, 17718, 18340, 18949, 19545, 20128, 20698, 21256, 21802, 22336,
+	22859, 23371,
+};
+
+/* Approximate val * y^n */
+static __always_inline u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	/* after bounds checking we can collapse to 32-bit */
+	local_n = n;
+
+	/* y^32 = 1/2, so shift out whole halvings first */
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	/* We don't use SRR here since we always want to round down. */
+	return val >> 32;
+}
+
+/* Computes 1024 * \Sum y^k { 1<=k<=n }, the contribution of n full periods */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	/* Compute \Sum y^k combining precomputed values for y^i, y^32 */
+	do {
+		contrib /= 2; /* y^LOAD_AVG_PERIOD = 1/2 */
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Account the time since the last update, during which @runnable tasks
+ * were runnable (0 or 1 for an entity, nr_running for a runqueue), and
+ * decay the history of @sa. Returns whether a period boundary was
+ * crossed.
+ */
+static __always_inline int __update_entity_runnable_avg(u64 now,
+						struct sched_avg *sa,
+						unsigned int runnable)
+{
+	u64 delta, periods;
+	u32 runnable_contrib;
+	int delta_w, decayed = 0;
+
+	delta = now - sa->last_runnable_update;
+	/*
+	 * This should only happen when time goes backwards, which it
+	 * unfortunately does during sched clock init when we swap over to TSC.
+	 */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	/* Use 1024ns as the unit of measurement since it's a reasonable
+	 * approximation of 1us and fast to compute. */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update = now;
+
+	/* delta_w is the amount already accumulated against our next period */
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		/* period roll-over */
+		decayed = 1;
+
+		/* Complete the current period, then decay the whole history */
+		delta_w = 1024 - delta_w;
+		sa->runnable_avg_sum += runnable * delta_w;
+		sa->runnable_avg_period += delta_w;
+
+		delta -= delta_w;
+
+		/* Figure out how many additional periods this update spans */
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		/* Efficiently calculate \sum (1..n_period) 1024*y^i */
+		runnable_contrib = __compute_runnable_contrib(periods);
+		sa->runnable_avg_sum += runnable * runnable_contrib;
+		sa->runnable_avg_period += runnable_contrib;
+	}
+
+	/* Remainder of delta accrued against the current period */
+	sa->runnable_avg_sum += runnable * delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+/* Update the runnable average of @se, before it is queued or dequeued */
+static void update_entity_load_avg(struct sched_entity *se)
+{
+	struct sched_avg *sa = &se->avg;
+
+	if (!__update_entity_runnable_avg(rq_of(cfs_rq_of(se))->clock_task,
+					  sa, se->on_rq))
+		return;
+
+	sa->load_avg_contrib = div_u64((u64)sa->runnable_avg_sum *
+				       se->load.weight,
+				       sa->runnable_avg_period + 1);
+}
+
+/* Called with rq->lock held, before rq->nr_running changes */
+void update_rq_runnable_avg(struct rq *rq)
+{
+	write_seqcount_begin(&rq->avg_seq);
+	__update_entity_runnable_avg(rq->clock, &rq->avg, !!rq->nr_running);
+	__update_entity_runnable_avg(rq->clock, &rq->nr_avg, rq->nr_running);
+	write_seqcount_end(&rq->avg_seq);
+}
+
+static unsigned int sched_avg_ratio(struct sched_avg *sa)
+{
+	return div_u64((u64)sa->runnable_avg_sum << SCHED_UTIL_SHIFT,
+		       sa->runnable_avg_period + 1);
+}
+
+/*
+ * The runqueue averages are only updated when nr_running changes and on
+ * the tick, which stops when the cpu is idle. Readers bring a copy up to
+ * date instead, so that they don't need the remote rq->lock; avg_seq
+ * keeps the copy consistent on 32-bit.
+ */
+static unsigned int sched_get_rq_avg(int cpu, struct sched_avg *avg,
+				     bool busy)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long nr_running, flags;
+	struct sched_avg sa;
+	unsigned int seq;
+	u64 now;
+
+	do {
+		seq = read_seqcount_begin(&rq->avg_seq);
+		nr_running = rq->nr_running;
+		sa = *avg;
+	} while (read_seqcount_retry(&rq->avg_seq, seq));
+
+	local_irq_save(flags);
+	now = sched_clock_cpu(cpu);
+	local_irq_restore(flags);
+
+	__update_entity_runnable_avg(now, &sa,
+				     busy ? !!nr_running : nr_running);
+	return sched_avg_ratio(&sa);
+}
+
+/**
+ * sched_get_cpu_util - recent fraction of time @cpu was busy
+ * @cpu: the cpu to query
+ *
+ * Returns the decayed fraction of time @cpu had a runnable task, from 0
+ * to 1 << SCHED_UTIL_SHIFT.
+ */
+unsigned int sched_get_cpu_util(int cpu)
+{
+	return sched_get_rq_avg(cpu, &cpu_rq(cpu)->avg, true);
+}
+EXPORT_SYMBOL_GPL(sched_get_cpu_util);
+
+/**
+ * sched_get_nr_running_avg - recent average number of runnable tasks
+ * @cpu: the cpu to query
+ *
+ * Returns the decayed average of nr_running on @cpu, scaled by
+ * 1 << SCHED_UTIL_SHIFT.
+ */
+unsigned int sched_get_nr_running_avg(int cpu)
+{
+	return sched_get_rq_avg(cpu, &cpu_rq(cpu)->nr_avg, false);
+}
+EXPORT_SYMBOL_GPL(sched_get_nr_running_avg);
+
+/**
+ * sched_get_task_util - recent fraction of time @p was runnable
+ * @p: the task to query
+ *
+ * Returns the fraction, from 0 to 1 << SCHED_UTIL_SHIFT, as of the last
+ * time @p was queued, dequeued or ticked.
+ */
+unsigned int sched_get_task_util(struct task_struct *p)
+{
+	return sched_avg_ratio(&p->se.avg);
+}
+EXPORT_SYMBOL_GPL(sched_get_task_util);
+
 static void check_enqueue_throttle(struct cfs_rq *cfs_rq);
 
 static void
@@ -1109,6 +1354,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	check_spread(cfs_rq, se);
 	if (se != cfs_rq->curr)
 		__enqueue_entity(cfs_rq, se);
+	update_entity_load_avg(se);
 	se->on_rq = 1;
 
 	if (cfs_rq->nr_running == 1) {
@@ -1190,6 +1436,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 
 	if (se != cfs_rq->curr)
 		__dequeue_entity(cfs_rq, se);
+	update_entity_load_avg(se);
 	se->on_rq = 0;
 	update_cfs_load(cfs_rq, 0);
 	account_entity_dequeue(cfs_rq, se);
@@ -1265,6 +1512,9 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 
 	update_stats_curr_start(cfs_rq, se);
 	cfs_rq->curr = se;
+	if (entity_is_task(se))
+		schedstat_wakeup_end(rq_of(cfs_rq), task_of(se),
+				     WAKEUP_LAT_FAIR);
 #ifdef CONFIG_SCHEDSTATS
 	/*
 	 * Track our maximum slice length, if the CPU's load is at
@@ -1351,6 +1601,7 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	update_entity_load_avg(curr);
 
 	/*
 	 * Update share accounting for long-running entities.
@@ -1648,8 +1899,10 @@ static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
 			dequeue = 0;
 	}
 
-	if (!se)
+	if (!se) {
+		update_rq_runnable_avg(rq);
 		rq->nr_running -= task_delta;
+	}
 
 	cfs_rq->throttled = 1;
 	cfs_rq->throttled_timestamp = rq->clock;
@@ -1696,8 +1949,10 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 			break;
 	}
 
-	if (!se)
+	if (!se) {
+		update_rq_runnable_avg(rq);
 		rq->nr_running += task_delta;
+	}
 
 	/* determine whether we need to wake up potentially idle cpu */
 	if (rq->curr == rq->idle && rq->cfs.nr_running)
@@ -1363,6 +1363,7 @@ static struct task_struct *_pick_next_task_rt(struct rq *rq)
 
 	p = rt_task_of(rt_se);
 	p->se.exec_start = rq->clock_task;
+	schedstat_wakeup_end(rq, p, WAKEUP_LAT_RT);
 
 	return p;
 }
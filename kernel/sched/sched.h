@@ -101,6 +101,25 @@ struct cfs_bandwidth {
 };
 
 /* task group related information */
+/*
+ * Wakeup to run latency histograms. Latencies are in units of 1024ns,
+ * bucket i counts those below 2^i units and the last one everything
+ * above.
+ */
+#define WAKEUP_LAT_BUCKETS	24
+
+enum {
+	WAKEUP_LAT_FAIR,
+	WAKEUP_LAT_RT,
+	WAKEUP_LAT_NR_CLASSES,
+};
+
+#ifdef CONFIG_SCHEDSTATS
+struct wakeup_lat_hist {
+	unsigned int count[WAKEUP_LAT_NR_CLASSES][WAKEUP_LAT_BUCKETS];
+};
+#endif
+
 struct task_group {
 	struct cgroup_subsys_state css;
 
@@ -133,6 +152,11 @@ struct task_group {
 #endif
 
 	struct cfs_bandwidth cfs_bandwidth;
+
+#ifdef CONFIG_SCHEDSTATS
+	/* wakeup latencies of the group's tasks, on each cpu */
+	struct wakeup_lat_hist __percpu *wakeup_lat;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -372,6 +396,10 @@ struct rq {
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
 	unsigned long nr_load_updates;
+	/* decayed busy time and nr_running, for sched_get_cpu_util() & co */
+	struct sched_avg avg;
+	struct sched_avg nr_avg;
+	seqcount_t avg_seq;
 	u64 nr_switches;
 
 	struct cfs_rq cfs;
@@ -467,6 +495,8 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	struct wakeup_lat_hist wakeup_lat;
 #endif
 
 #ifdef CONFIG_SMP
@@ -924,13 +954,17 @@ extern void cpuacct_charge(struct task_struct *tsk, u64 cputime);
 static inline void cpuacct_charge(struct task_struct *tsk, u64 cputime) {}
 #endif
 
+extern void update_rq_runnable_avg(struct rq *rq);
+
 static inline void inc_nr_running(struct rq *rq)
 {
+	update_rq_runnable_avg(rq);
 	rq->nr_running++;
 }
 
 static inline void dec_nr_running(struct rq *rq)
 {
+	update_rq_runnable_avg(rq);
 	rq->nr_running--;
 }
 
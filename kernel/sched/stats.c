@@ -103,9 +103,84 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = single_release,
 };
 
+void __schedstat_wakeup_end(struct rq *rq, struct task_struct *p, int class)
+{
+	/*
+	 * The start stamp comes from the waking rq's clock, which may run
+	 * ahead of ours after a migration or a skipped clock update; count
+	 * such wakeups as zero latency rather than letting them wrap.
+	 */
+	s64 delta = rq->clock - p->se.statistics.wakeup_start;
+	int bucket;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg = task_group(p);
+#endif
+
+	if (delta < 0)
+		delta = 0;
+	delta >>= 10;
+	bucket = delta > UINT_MAX ? WAKEUP_LAT_BUCKETS - 1 :
+		 min(fls(delta), WAKEUP_LAT_BUCKETS - 1);
+#ifdef CONFIG_CGROUP_SCHED
+	if (tg->wakeup_lat)
+		per_cpu_ptr(tg->wakeup_lat,
+			    cpu_of(rq))->count[class][bucket]++;
+#endif
+
+	p->se.statistics.wakeup_start = 0;
+	rq->wakeup_lat.count[class][bucket]++;
+}
+
+static const char * const wakeup_lat_class[WAKEUP_LAT_NR_CLASSES] = {
+	[WAKEUP_LAT_FAIR]	= "fair",
+	[WAKEUP_LAT_RT]		= "rt",
+};
+
+/* Prints one line per class of @hist, prefixed with @prefix */
+void show_wakeup_lat(struct seq_file *seq, const char *prefix,
+		     const struct wakeup_lat_hist *hist)
+{
+	int class, bucket;
+
+	for (class = 0; class < WAKEUP_LAT_NR_CLASSES; class++) {
+		seq_printf(seq, "%s%s", prefix, wakeup_lat_class[class]);
+		for (bucket = 0; bucket < WAKEUP_LAT_BUCKETS; bucket++)
+			seq_printf(seq, " %u", hist->count[class][bucket]);
+		seq_putc(seq, '\n');
+	}
+}
+
+static int show_wakeup_latency(struct seq_file *seq, void *v)
+{
+	char prefix[16];
+	int cpu;
+
+	seq_printf(seq, "version 1\n");
+	seq_printf(seq, "buckets %d unit_ns 1024\n", WAKEUP_LAT_BUCKETS);
+	for_each_online_cpu(cpu) {
+		snprintf(prefix, sizeof(prefix), "cpu%d ", cpu);
+		show_wakeup_lat(seq, prefix, &cpu_rq(cpu)->wakeup_lat);
+	}
+	return 0;
+}
+
+static int wakeup_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_wakeup_latency, NULL);
+}
+
+static const struct file_operations proc_wakeup_latency_operations = {
+	.open    = wakeup_latency_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
+	proc_create("sched_wakeup_latency", 0, NULL,
+		    &proc_wakeup_latency_operations);
 	return 0;
 }
 module_init(proc_schedstat_init);
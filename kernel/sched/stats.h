@@ -29,6 +29,30 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+/*
+ * Expects runqueue lock to be held. A task woken while still running
+ * on its cpu doesn't wait to run, so it isn't timed.
+ */
+static inline void
+schedstat_wakeup_start(struct rq *rq, struct task_struct *p)
+{
+	if (p != rq->curr)
+		p->se.statistics.wakeup_start = rq->clock;
+}
+
+extern void __schedstat_wakeup_end(struct rq *rq, struct task_struct *p,
+				   int class);
+extern void show_wakeup_lat(struct seq_file *seq, const char *prefix,
+			    const struct wakeup_lat_hist *hist);
+
+/* Called when @p is picked to run, with the runqueue lock held */
+static inline void
+schedstat_wakeup_end(struct rq *rq, struct task_struct *p, int class)
+{
+	if (p->se.statistics.wakeup_start)
+		__schedstat_wakeup_end(rq, p, class);
+}
 # define schedstat_inc(rq, field)	do { (rq)->field++; } while (0)
 # define schedstat_add(rq, field, amt)	do { (rq)->field += (amt); } while (0)
 # define schedstat_set(var, val)	do { var = (val); } while (0)
@@ -42,6 +66,12 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void
+schedstat_wakeup_start(struct rq *rq, struct task_struct *p)
+{}
+static inline void
+schedstat_wakeup_end(struct rq *rq, struct task_struct *p, int class)
+{}
 # define schedstat_inc(rq, field)	do { } while (0)
 # define schedstat_add(rq, field, amt)	do { } while (0)
 # define schedstat_set(var, val)	do { } while (0)
@@ -775,6 +775,7 @@ static void update_rq_stats(void)
 	unsigned long jiffy_gap = 0;
 	unsigned int rq_avg = 0;
 	unsigned long flags = 0;
+	int cpu;
 
 	jiffy_gap = jiffies - rq_info.rq_poll_last_jiffy;
 
@@ -785,7 +786,10 @@ static void update_rq_stats(void)
 		if (!rq_info.rq_avg)
 			rq_info.rq_poll_total_jiffies = 0;
 
-		rq_avg = nr_running() * 10;
+		/* Decayed nr_running, bursts between ticks count too */
+		for_each_online_cpu(cpu)
+			rq_avg += sched_get_nr_running_avg(cpu);
+		rq_avg = (rq_avg * 10) >> SCHED_UTIL_SHIFT;
 
 		if (rq_info.rq_poll_total_jiffies) {
 			rq_avg = (rq_avg * jiffy_gap) +
@@ -0,0 +1,41 @@
+/*
+ *  lz4defs.h -- LZ4 block format constants
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+/*
+ * A block is a series of sequences. Each sequence is a token byte, an
+ * optional literal length extension, the literals, a 16 bit little
+ * endian match offset and an optional match length extension. The last
+ * sequence only has literals.
+ */
+#define MINMATCH	4
+
+/* The last LASTLITERALS bytes of a block are always literals */
+#define LASTLITERALS	5
+/* and the last match must start at least MFLIMIT bytes before the end */
+#define MFLIMIT		(8 + MINMATCH)
+#define LZ4_MIN_LENGTH	(MFLIMIT + 1)
+
+#define MAX_DISTANCE	0xffff
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define HASH_LOG	12
+#define HASH_SIZE	(1U << HASH_LOG)
+
+/*
+ * Once this many positions in a row failed to find a match, the
+ * compressor starts skipping ahead, faster and faster, so that
+ * incompressible input is given up on quickly.
+ */
+#define SKIP_TRIGGER	6
+
+#define LZ4_HASH(p)	\
+	((get_unaligned((const u32 *)(p)) * 2654435761U) >> (32 - HASH_LOG))
@@ -0,0 +1,219 @@
+/*
+ * Memory pressure reporting
+ *
+ * Reclaim reports how many pages it scanned and how many of them it
+ * freed. Once a window of scanned pages has been accumulated, the share
+ * of pages that could not be freed is passed to the registered
+ * notifiers and made available in /proc/vmpressure, which can be polled
+ * for new reports.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/log2.h>
+#include <linux/poll.h>
+#include <linux/proc_fs.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/vmpressure.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+
+/*
+ * Number of scanned pages after which the pressure is computed. 512
+ * pages (2MB with 4K pages) keep the reports cheap while still reacting
+ * quickly enough to a burst of allocations.
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+/* Pressure (in percent) from which the medium and critical levels start */
+static const unsigned long vmpressure_level_med = 60;
+static const unsigned long vmpressure_level_critical = 95;
+
+/*
+ * Reclaim priority from which pressure is critical regardless of the
+ * ratio: at priority 3 reclaim is scanning 1/8 of the LRUs, i.e. it is
+ * about to start thrashing.
+ */
+static const int vmpressure_level_critical_prio = ilog2(100 / 10);
+
+static const char * const vmpressure_str_levels[] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+static DEFINE_SPINLOCK(vmpressure_lock);
+static unsigned long vmpressure_scanned;
+static unsigned long vmpressure_reclaimed;
+
+static BLOCKING_NOTIFIER_HEAD(vmpressure_notifier);
+
+/* Last report, read through /proc/vmpressure */
+static DECLARE_WAIT_QUEUE_HEAD(vmpressure_wait);
+static atomic_t vmpressure_seq = ATOMIC_INIT(0);
+static unsigned long vmpressure_last;
+
+enum vmpressure_levels vmpressure_level(unsigned long pressure)
+{
+	if (pressure >= vmpressure_level_critical)
+		return VMPRESSURE_CRITICAL;
+	else if (pressure >= vmpressure_level_med)
+		return VMPRESSURE_MEDIUM;
+	return VMPRESSURE_LOW;
+}
+
+static unsigned long vmpressure_calc(unsigned long scanned,
+				     unsigned long reclaimed)
+{
+	/*
+	 * Reclaimed can exceed scanned when slab pages or huge pages were
+	 * freed; there is no pressure in that case.
+	 */
+	if (reclaimed >= scanned)
+		return 0;
+
+	return 100 - reclaimed * 100 / scanned;
+}
+
+static void vmpressure_work_fn(struct work_struct *work)
+{
+	unsigned long scanned, reclaimed, pressure;
+
+	spin_lock(&vmpressure_lock);
+	scanned = vmpressure_scanned;
+	reclaimed = vmpressure_reclaimed;
+	vmpressure_scanned = 0;
+	vmpressure_reclaimed = 0;
+	spin_unlock(&vmpressure_lock);
+
+	if (!scanned)
+		return;
+
+	pressure = vmpressure_calc(scanned, reclaimed);
+
+	vmpressure_last = pressure;
+	smp_wmb();
+	atomic_inc(&vmpressure_seq);
+	wake_up_interruptible(&vmpressure_wait);
+
+	blocking_notifier_call_chain(&vmpressure_notifier, pressure, NULL);
+}
+
+static DECLARE_WORK(vmpressure_work, vmpressure_work_fn);
+
+/**
+ * vmpressure() - account reclaim efficiency
+ * @gfp:	reclaimer's gfp mask
+ * @scanned:	number of pages scanned
+ * @reclaimed:	number of pages reclaimed
+ *
+ * Called by reclaim after each zone is shrunk. The pressure is computed
+ * and reported from a work item once enough pages were scanned, so this
+ * is cheap enough for the reclaim path.
+ */
+void vmpressure(gfp_t gfp, unsigned long scanned, unsigned long reclaimed)
+{
+	/*
+	 * Only allocations that could use any page, i.e. highmem or
+	 * movable, and that can do IO tell something about the pressure
+	 * on the LRUs.
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	if (!scanned)
+		return;
+
+	spin_lock(&vmpressure_lock);
+	vmpressure_scanned += scanned;
+	vmpressure_reclaimed += reclaimed;
+	scanned = vmpressure_scanned;
+	spin_unlock(&vmpressure_lock);
+
+	if (scanned < vmpressure_win)
+		return;
+	schedule_work(&vmpressure_work);
+}
+
+/**
+ * vmpressure_prio() - account reclaim priority level
+ * @gfp:	reclaimer's gfp mask
+ * @prio:	reclaimer's priority
+ *
+ * Reclaim reaching a low priority is reported as critical pressure,
+ * even if the pages scanned so far could be freed.
+ */
+void vmpressure_prio(gfp_t gfp, int prio)
+{
+	if (prio > vmpressure_level_critical_prio)
+		return;
+
+	/* a full window without a single reclaimed page */
+	vmpressure(gfp, vmpressure_win, 0);
+}
+
+int vmpressure_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&vmpressure_notifier, nb);
+}
+
+int vmpressure_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&vmpressure_notifier, nb);
+}
+
+/*
+ * /proc/vmpressure shows the level and pressure of the last report.
+ * poll() returns once a report newer than the last one read is
+ * available.
+ */
+static int vmpressure_open(struct inode *inode, struct file *file)
+{
+	file->private_data = (void *)(long)atomic_read(&vmpressure_seq);
+	return 0;
+}
+
+static ssize_t vmpressure_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char tmp[32];
+	unsigned long pressure;
+	int seq, len;
+
+	seq = atomic_read(&vmpressure_seq);
+	smp_rmb();
+	pressure = vmpressure_last;
+	file->private_data = (void *)(long)seq;
+
+	len = snprintf(tmp, sizeof(tmp), "%s %lu\n",
+		       vmpressure_str_levels[vmpressure_level(pressure)],
+		       pressure);
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+static unsigned int vmpressure_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &vmpressure_wait, wait);
+
+	if (atomic_read(&vmpressure_seq) != (long)file->private_data)
+		return POLLIN | POLLRDNORM | POLLPRI;
+	return 0;
+}
+
+static const struct file_operations vmpressure_fops = {
+	.open		= vmpressure_open,
+	.read		= vmpressure_read,
+	.poll		= vmpressure_poll,
+	.llseek		= default_llseek,
+};
+
+static int __init vmpressure_init(void)
+{
+	proc_create("vmpressure", S_IRUGO, NULL, &vmpressure_fops);
+	return 0;
+}
+module_init(vmpressure_init);
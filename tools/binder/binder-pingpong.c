@@ -0,0 +1,464 @@
+/*
+ * binder-pingpong: binder transaction round trip benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * Runs 1 to N client/server pairs, each pair pinned to its own two CPUs,
+ * and reports how many synchronous transactions per second they complete
+ * together. With independent pairs the total should grow linearly with
+ * the number of pairs, unless the driver serializes them.
+ *
+ * The benchmark hands out the server handles as the context manager, so
+ * it has to run as the context manager uid (usually root) while no
+ * servicemanager is registered.
+ *
+ * The 99th percentile round trip latency is printed as well, which is
+ * what large payloads (-s up to 1M) mostly affect.
+ *
+ *	binder-pingpong [-p max_pairs] [-t seconds] [-s payload_bytes]
+ */
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../../drivers/staging/android/binder.h"
+
+#define MAP_SIZE	(4 * 1024 * 1024)
+#define MAX_PAYLOAD	(1024 * 1024)
+#define MAX_LAT_US	100000	/* latencies above are counted here */
+#define BATCH		64
+
+/* Transaction codes, the pair number is in the upper bits */
+#define CMD_REGISTER	1
+#define CMD_LOOKUP	2
+#define CMD_PING	3
+#define CMD_MASK	0xff
+#define CMD_PAIR_SHIFT	8
+
+struct binder {
+	int fd;
+	void *map;
+	size_t wlen;
+	uint32_t wbuf[64];	/* commands for the next write */
+};
+
+struct result {
+	unsigned long count;
+	long long ns;
+	long p99_us;
+};
+
+static int nr_cpus;
+static int seconds = 1;
+static int payload = 32;
+static char payload_buf[MAX_PAYLOAD];
+static unsigned long lat_us[MAX_LAT_US + 1];
+
+static void die(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % nr_cpus, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity");
+}
+
+static void binder_init(struct binder *b)
+{
+	b->fd = open("/dev/binder", O_RDWR);
+	if (b->fd < 0)
+		die("/dev/binder");
+	b->map = mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0);
+	if (b->map == MAP_FAILED)
+		die("mmap");
+	b->wlen = 0;
+}
+
+static void put_data(struct binder *b, const void *data, size_t len)
+{
+	if (b->wlen + len > sizeof(b->wbuf)) {
+		fprintf(stderr, "command buffer full\n");
+		exit(1);
+	}
+	memcpy((char *)b->wbuf + b->wlen, data, len);
+	b->wlen += len;
+}
+
+static void put_u32(struct binder *b, uint32_t val)
+{
+	put_data(b, &val, sizeof(val));
+}
+
+static void put_free_buffer(struct binder *b, const void *buffer)
+{
+	put_u32(b, BC_FREE_BUFFER);
+	put_data(b, &buffer, sizeof(buffer));
+}
+
+static void put_transaction(struct binder *b, uint32_t cmd, size_t handle,
+			    uint32_t code, const void *data, size_t size,
+			    const size_t *offsets, size_t offsets_size)
+{
+	struct binder_transaction_data tr;
+
+	memset(&tr, 0, sizeof(tr));
+	tr.target.handle = handle;
+	tr.code = code;
+	tr.data_size = size;
+	tr.offsets_size = offsets_size;
+	tr.data.ptr.buffer = data;
+	tr.data.ptr.offsets = offsets;
+	put_u32(b, cmd);
+	put_data(b, &tr, sizeof(tr));
+}
+
+/*
+ * Write the pending commands and, if @rbuf is given, read what the
+ * driver returns. Returns the number of bytes read.
+ */
+static size_t binder_write_read(struct binder *b, void *rbuf, size_t rsize)
+{
+	struct binder_write_read bwr;
+	int ret;
+
+	do {
+		bwr.write_size = b->wlen;
+		bwr.write_consumed = 0;
+		bwr.write_buffer = (unsigned long)b->wbuf;
+		bwr.read_size = rsize;
+		bwr.read_consumed = 0;
+		bwr.read_buffer = (unsigned long)rbuf;
+		ret = ioctl(b->fd, BINDER_WRITE_READ, &bwr);
+		b->wlen -= bwr.write_consumed;
+		memmove(b->wbuf, (char *)b->wbuf + bwr.write_consumed,
+			b->wlen);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		die("BINDER_WRITE_READ");
+
+	return bwr.read_consumed;
+}
+
+/*
+ * Write the pending commands, then read until a transaction or a reply
+ * arrives. Reference count requests of the driver are acknowledged with
+ * the next write. Returns BR_TRANSACTION or BR_REPLY.
+ */
+static uint32_t binder_wait(struct binder *b,
+			    struct binder_transaction_data *tr)
+{
+	char rbuf[256];
+
+	for (;;) {
+		char *p = rbuf;
+		char *end = rbuf + binder_write_read(b, rbuf, sizeof(rbuf));
+
+		while (p < end) {
+			uint32_t cmd = *(uint32_t *)p;
+
+			p += sizeof(cmd);
+			switch (cmd) {
+			case BR_NOOP:
+			case BR_TRANSACTION_COMPLETE:
+			case BR_SPAWN_LOOPER:
+				break;
+			case BR_INCREFS:
+			case BR_ACQUIRE:
+				put_u32(b, cmd == BR_INCREFS ?
+					BC_INCREFS_DONE : BC_ACQUIRE_DONE);
+				put_data(b, p, sizeof(struct binder_ptr_cookie));
+				p += sizeof(struct binder_ptr_cookie);
+				break;
+			case BR_RELEASE:
+			case BR_DECREFS:
+				p += sizeof(struct binder_ptr_cookie);
+				break;
+			case BR_TRANSACTION:
+			case BR_REPLY:
+				/* The driver returns one transaction per read */
+				memcpy(tr, p, sizeof(*tr));
+				return cmd;
+			default:
+				fprintf(stderr, "%d: unexpected return %x\n",
+					getpid(), cmd);
+				exit(1);
+			}
+		}
+	}
+}
+
+static void server(int pair)
+{
+	struct binder b;
+	struct binder_transaction_data tr;
+	struct flat_binder_object obj;
+	size_t offset = 0;
+
+	pin(2 * pair);
+	binder_init(&b);
+	put_u32(&b, BC_ENTER_LOOPER);
+
+	memset(&obj, 0, sizeof(obj));
+	obj.type = BINDER_TYPE_BINDER;
+	obj.binder = &b;
+	put_transaction(&b, BC_TRANSACTION, 0,
+			CMD_REGISTER | pair << CMD_PAIR_SHIFT,
+			&obj, sizeof(obj), &offset, sizeof(offset));
+	if (binder_wait(&b, &tr) != BR_REPLY)
+		exit(1);
+	put_free_buffer(&b, tr.data.ptr.buffer);
+
+	for (;;) {
+		if (binder_wait(&b, &tr) != BR_TRANSACTION)
+			exit(1);
+		put_free_buffer(&b, tr.data.ptr.buffer);
+		put_transaction(&b, BC_REPLY, 0, 0, payload_buf, payload,
+				NULL, 0);
+	}
+}
+
+static void client(int pair, int go_fd, int result_fd)
+{
+	struct binder b;
+	struct binder_transaction_data tr;
+	struct flat_binder_object obj;
+	struct result res;
+	uint32_t handle;
+	long long start, t, lat;
+	unsigned long seen;
+	char go;
+	int i;
+
+	pin(2 * pair + 1);
+	binder_init(&b);
+
+	put_transaction(&b, BC_TRANSACTION, 0,
+			CMD_LOOKUP | pair << CMD_PAIR_SHIFT, NULL, 0, NULL, 0);
+	if (binder_wait(&b, &tr) != BR_REPLY ||
+	    tr.data_size < sizeof(obj))
+		exit(1);
+	memcpy(&obj, tr.data.ptr.buffer, sizeof(obj));
+	if (obj.type != BINDER_TYPE_HANDLE)
+		exit(1);
+	handle = obj.handle;
+	/* Keep the handle once the reply buffer is gone */
+	put_u32(&b, BC_ACQUIRE);
+	put_u32(&b, handle);
+	put_free_buffer(&b, tr.data.ptr.buffer);
+	binder_write_read(&b, NULL, 0);
+
+	if (read(go_fd, &go, 1) != 1)
+		die("read");
+
+	res.count = 0;
+	start = now_ns();
+	do {
+		for (i = 0; i < BATCH; i++) {
+			t = now_ns();
+			put_transaction(&b, BC_TRANSACTION, handle, CMD_PING,
+					payload_buf, payload, NULL, 0);
+			if (binder_wait(&b, &tr) != BR_REPLY)
+				exit(1);
+			put_free_buffer(&b, tr.data.ptr.buffer);
+			lat = (now_ns() - t) / 1000;
+			lat_us[lat < MAX_LAT_US ? lat : MAX_LAT_US]++;
+		}
+		res.count += BATCH;
+		res.ns = now_ns() - start;
+	} while (res.ns < seconds * 1000000000LL);
+	binder_write_read(&b, NULL, 0);
+
+	seen = 0;
+	for (res.p99_us = 0; res.p99_us < MAX_LAT_US; res.p99_us++) {
+		seen += lat_us[res.p99_us];
+		if (seen * 100 >= res.count * 99)
+			break;
+	}
+
+	if (write(result_fd, &res, sizeof(res)) != sizeof(res))
+		die("write");
+	exit(0);
+}
+
+/* Handle one request of a server or a client */
+static void serve(struct binder *mgr, uint32_t *handles)
+{
+	static struct flat_binder_object obj;
+	static size_t offset;
+	struct binder_transaction_data tr;
+	int pair;
+
+	if (binder_wait(mgr, &tr) != BR_TRANSACTION)
+		exit(1);
+	pair = tr.code >> CMD_PAIR_SHIFT;
+
+	switch (tr.code & CMD_MASK) {
+	case CMD_REGISTER:
+		if (tr.data_size < sizeof(obj))
+			exit(1);
+		memcpy(&obj, tr.data.ptr.buffer, sizeof(obj));
+		handles[pair] = obj.handle;
+		put_u32(mgr, BC_ACQUIRE);
+		put_u32(mgr, handles[pair]);
+		put_free_buffer(mgr, tr.data.ptr.buffer);
+		put_transaction(mgr, BC_REPLY, 0, 0, NULL, 0, NULL, 0);
+		break;
+	case CMD_LOOKUP:
+		put_free_buffer(mgr, tr.data.ptr.buffer);
+		memset(&obj, 0, sizeof(obj));
+		obj.type = BINDER_TYPE_HANDLE;
+		obj.handle = handles[pair];
+		offset = 0;
+		put_transaction(mgr, BC_REPLY, 0, 0, &obj, sizeof(obj),
+				&offset, sizeof(offset));
+		break;
+	default:
+		fprintf(stderr, "unexpected request %x\n", tr.code);
+		exit(1);
+	}
+}
+
+static void run(struct binder *mgr, int pairs)
+{
+	pid_t pids[2 * pairs];
+	uint32_t handles[pairs];
+	int go[2], results[2];
+	double total = 0;
+	long p99_us = 0;
+	struct result res;
+	int i;
+
+	if (pipe(go) || pipe(results))
+		die("pipe");
+
+	for (i = 0; i < pairs; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			die("fork");
+		if (!pids[i])
+			server(i);
+	}
+	for (i = 0; i < pairs; i++)
+		serve(mgr, handles);
+
+	for (i = 0; i < pairs; i++) {
+		pids[pairs + i] = fork();
+		if (pids[pairs + i] < 0)
+			die("fork");
+		if (!pids[pairs + i])
+			client(i, go[0], results[1]);
+	}
+	for (i = 0; i < pairs; i++)
+		serve(mgr, handles);
+	binder_write_read(mgr, NULL, 0);
+
+	/* Start all clients at once */
+	for (i = 0; i < pairs; i++)
+		if (write(go[1], "g", 1) != 1)
+			die("write");
+	for (i = 0; i < pairs; i++) {
+		if (read(results[0], &res, sizeof(res)) != sizeof(res))
+			die("read");
+		total += res.count * 1e9 / res.ns;
+		if (res.p99_us > p99_us)
+			p99_us = res.p99_us;
+	}
+	printf("%5d %15.0f %15.0f %10ld\n", pairs, total, total / pairs,
+	       p99_us);
+	fflush(stdout);
+
+	for (i = 0; i < pairs; i++) {
+		put_u32(mgr, BC_RELEASE);
+		put_u32(mgr, handles[i]);
+	}
+	binder_write_read(mgr, NULL, 0);
+
+	for (i = 0; i < pairs; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < 2 * pairs; i++)
+		waitpid(pids[i], NULL, 0);
+	close(go[0]);
+	close(go[1]);
+	close(results[0]);
+	close(results[1]);
+}
+
+int main(int argc, char **argv)
+{
+	struct binder mgr;
+	int max_pairs;
+	int pairs;
+	int c;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	max_pairs = nr_cpus > 1 ? nr_cpus / 2 : 1;
+
+	while ((c = getopt(argc, argv, "p:t:s:")) != -1) {
+		switch (c) {
+		case 'p':
+			max_pairs = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 's':
+			payload = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p max_pairs] [-t seconds]"
+				" [-s payload_bytes]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (max_pairs < 1 || seconds < 1 ||
+	    payload < 0 || payload > MAX_PAYLOAD) {
+		fprintf(stderr, "invalid argument\n");
+		return 1;
+	}
+
+	binder_init(&mgr);
+	if (ioctl(mgr.fd, BINDER_SET_CONTEXT_MGR, 0) < 0)
+		die("BINDER_SET_CONTEXT_MGR");
+	put_u32(&mgr, BC_ENTER_LOOPER);
+
+	printf("pairs   round trips/s      per pair/s    p99 us\n");
+	for (pairs = 1; pairs <= max_pairs; pairs++)
+		run(&mgr, pairs);
+
+	return 0;
+}